@@ -0,0 +1,167 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "counters.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<std::size_t> heap_allocations(0);
+
+void* operator new(std::size_t size)
+{
+	++heap_allocations;
+
+	auto result = std::malloc(size == 0 ? 1 : size);
+	if (result == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* value) noexcept
+{
+	std::free(value);
+}
+
+void operator delete[](void* value) noexcept
+{
+	std::free(value);
+}
+
+void operator delete(void* value, std::size_t) noexcept
+{
+	std::free(value);
+}
+
+void operator delete[](void* value, std::size_t) noexcept
+{
+	std::free(value);
+}
+
+std::size_t benchmark::get_heap_allocations()
+{
+	return heap_allocations.load(std::memory_order_relaxed);
+}
+
+benchmark::CacheMissCounter::CacheMissCounter()
+{
+#ifdef __linux__
+	perf_event_attr attributes;
+	std::memset(&attributes, 0, sizeof(attributes));
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.size = sizeof(attributes);
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.disabled = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+
+	fd = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+}
+
+benchmark::CacheMissCounter::~CacheMissCounter()
+{
+#ifdef __linux__
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+#endif
+}
+
+bool benchmark::CacheMissCounter::available() const
+{
+	return fd >= 0;
+}
+
+void benchmark::CacheMissCounter::start()
+{
+#ifdef __linux__
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+std::uint64_t benchmark::CacheMissCounter::stop()
+{
+	std::uint64_t count = 0;
+
+#ifdef __linux__
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count))
+		{
+			count = 0;
+		}
+	}
+#endif
+
+	return count;
+}
+
+void benchmark::Stopwatch::start()
+{
+	begin = std::chrono::steady_clock::now();
+}
+
+double benchmark::Stopwatch::stop()
+{
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+void benchmark::print_header()
+{
+	std::printf(
+		"%-24s %8s %10s %12s %12s %12s %14s\n",
+		"benchmark", "nodes", "ticks", "ns/tick", "allocs/tick", "new/tick", "misses/tick");
+}
+
+void benchmark::print_result(const Result& result)
+{
+	char misses[32];
+	if (result.has_cache_misses)
+	{
+		std::snprintf(misses, sizeof(misses), "%.2f", result.cache_misses_per_tick);
+	}
+	else
+	{
+		std::snprintf(misses, sizeof(misses), "n/a");
+	}
+
+	std::printf(
+		"%-24s %8zu %10zu %12.1f %12.2f %12.2f %14s\n",
+		result.name,
+		result.nodes,
+		result.ticks,
+		result.nanoseconds_per_tick,
+		result.allocations_per_tick,
+		result.heap_allocations_per_tick,
+		misses);
+}
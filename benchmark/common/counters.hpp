@@ -0,0 +1,68 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_BENCHMARK_COUNTERS_HPP
+#define BMASHINA_BENCHMARK_COUNTERS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace benchmark
+{
+	// Number of global operator new calls made so far by the process.
+	std::size_t get_heap_allocations();
+
+	// Counts hardware cache misses on the calling thread. Backed by
+	// perf_event_open on Linux; elsewhere, or when the kernel refuses the
+	// event, available() is false and stop() returns zero.
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter();
+		CacheMissCounter(const CacheMissCounter& other) = delete;
+		~CacheMissCounter();
+
+		bool available() const;
+
+		void start();
+		std::uint64_t stop();
+
+		CacheMissCounter& operator =(const CacheMissCounter& other) = delete;
+
+	private:
+		int fd = -1;
+	};
+
+	class Stopwatch
+	{
+	public:
+		void start();
+		double stop();
+
+	private:
+		std::chrono::steady_clock::time_point begin;
+	};
+
+	struct Result
+	{
+		const char* name;
+		std::size_t nodes;
+		std::size_t ticks;
+		double nanoseconds_per_tick;
+		double allocations_per_tick;
+		double heap_allocations_per_tick;
+		double cache_misses_per_tick;
+		bool has_cache_misses;
+	};
+
+	void print_header();
+	void print_result(const Result& result);
+}
+
+#endif
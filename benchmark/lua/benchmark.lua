@@ -0,0 +1,84 @@
+--------------------------------------------------------------------------------
+-- benchmark/lua/benchmark.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+local B = require "B"
+local TreeBuilder = require "B.TreeBuilder"
+
+B._ROOT = "nodes"
+
+local TICKS = tonumber(...) or 100000
+
+local function node(name, children)
+	return TreeBuilder.Root()[name](children or {})
+end
+
+local function leaves(name, count)
+	local result = {}
+	for i = 1, count do
+		table.insert(result, node(name))
+	end
+
+	return result
+end
+
+local function run(name, nodes, definition)
+	local mashina = {}
+	local tree = TreeBuilder.materialize(mashina, TreeBuilder.Root() { definition })
+	local executor = B.Executor(mashina)
+
+	benchmark.run(name, nodes, TICKS, function()
+		tree:execute(executor)
+	end)
+end
+
+-- Fixed cost of a tick: one Lua leaf as the root.
+run("lua_single_leaf", 1, node("Succeed"))
+
+-- Update crossings: a Lua sequence over 64 Lua leaves.
+run("lua_update", 65, node("Sequence", leaves("Succeed", 64)))
+
+-- Toggle alternates between its two subtrees every tick, so one subtree is
+-- activated and the other deactivated on each tick. The plain variant has no
+-- activated/deactivated handlers; the difference between the two is the
+-- cost of the event crossings.
+run("lua_toggle_plain", 67, node("Toggle", {
+	node("Sequence", leaves("Succeed", 32)),
+	node("Sequence", leaves("Succeed", 32))
+}))
+
+run("lua_toggle_events", 67, node("Toggle", {
+	node("Sequence", leaves("Observed", 32)),
+	node("Sequence", leaves("Observed", 32))
+}))
+
+-- Ticking 100 agents over one tree, one Lua call per agent versus a single
+-- batched B.execute call. Each tick covers all agents.
+do
+	local AGENTS = 100
+
+	local mashina = {}
+	local tree = TreeBuilder.materialize(mashina, TreeBuilder.Root() { node("Succeed") })
+	local executors = {}
+	for i = 1, AGENTS do
+		table.insert(executors, B.Executor(mashina))
+	end
+
+	local results = {}
+	local ticks = math.max(1, math.floor(TICKS / AGENTS))
+
+	benchmark.run("lua_agents_loop", AGENTS, ticks, function()
+		for i = 1, #executors do
+			results[i] = tree:execute(executors[i])
+		end
+	end)
+
+	benchmark.run("lua_agents_batched", AGENTS, ticks, function()
+		B.execute(executors, tree, results)
+	end)
+end
@@ -0,0 +1,167 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <lua.hpp>
+#include "counters.hpp"
+
+extern "C" int luaopen_bmashina(lua_State* L);
+
+static std::size_t lua_allocations = 0;
+
+static void* allocate(void* userdata, void* pointer, std::size_t old_size, std::size_t new_size)
+{
+	if (new_size == 0)
+	{
+		std::free(pointer);
+		return nullptr;
+	}
+
+	if (pointer == nullptr || new_size > old_size)
+	{
+		++lua_allocations;
+	}
+
+	return std::realloc(pointer, new_size);
+}
+
+static void tick(lua_State* L, int index)
+{
+	lua_pushvalue(L, index);
+	lua_call(L, 0, 0);
+}
+
+// benchmark.run(name, nodes, ticks, f) calls f ticks times and prints the
+// cost per call. Lua allocations are reported as allocs/tick.
+static int benchmark_run(lua_State* L)
+{
+	const char* name = luaL_checkstring(L, 1);
+	auto nodes = (std::size_t)luaL_checkinteger(L, 2);
+	auto ticks = (std::size_t)luaL_checkinteger(L, 3);
+	luaL_checktype(L, 4, LUA_TFUNCTION);
+
+	if (ticks == 0)
+	{
+		return luaL_error(L, "ticks must be positive");
+	}
+
+	for (std::size_t i = 0; i < 16; ++i)
+	{
+		tick(L, 4);
+	}
+	lua_gc(L, LUA_GCCOLLECT, 0);
+
+	benchmark::CacheMissCounter cache_misses;
+	benchmark::Stopwatch stopwatch;
+
+	auto allocations = lua_allocations;
+	auto heap_allocations = benchmark::get_heap_allocations();
+
+	cache_misses.start();
+	stopwatch.start();
+	for (std::size_t i = 0; i < ticks; ++i)
+	{
+		tick(L, 4);
+	}
+	auto nanoseconds = stopwatch.stop();
+	auto misses = cache_misses.stop();
+
+	allocations = lua_allocations - allocations;
+	heap_allocations = benchmark::get_heap_allocations() - heap_allocations;
+
+	benchmark::Result result;
+	result.name = name;
+	result.nodes = nodes;
+	result.ticks = ticks;
+	result.nanoseconds_per_tick = nanoseconds / ticks;
+	result.allocations_per_tick = (double)allocations / ticks;
+	result.heap_allocations_per_tick = (double)heap_allocations / ticks;
+	result.cache_misses_per_tick = (double)misses / ticks;
+	result.has_cache_misses = cache_misses.available();
+	benchmark::print_result(result);
+
+	return 0;
+}
+
+static int traceback(lua_State* L)
+{
+	lua_getfield(L, LUA_GLOBALSINDEX, "debug");
+	lua_getfield(L, -1, "traceback");
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, 2);
+	lua_call(L, 2, 1);
+
+	return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+	const char* ticks = "100000";
+	std::string root = ".";
+	if (argc > 1)
+	{
+		ticks = argv[1];
+	}
+	if (argc > 2)
+	{
+		root = argv[2];
+	}
+
+	lua_State* L = lua_newstate(&allocate, nullptr);
+	if (L == nullptr)
+	{
+		std::fprintf(stderr, "could not create Lua state\n");
+		return 1;
+	}
+	luaL_openlibs(L);
+
+	lua_getfield(L, LUA_GLOBALSINDEX, "package");
+	lua_getfield(L, -1, "preload");
+	lua_pushcfunction(L, &luaopen_bmashina);
+	lua_setfield(L, -2, "bmashina");
+	lua_pop(L, 1);
+
+	std::string path =
+		root + "/lmashina/lua/?.lua;" +
+		root + "/lmashina/lua/?/init.lua;" +
+		root + "/benchmark/lua/?.lua";
+	lua_pushstring(L, path.c_str());
+	lua_setfield(L, -2, "path");
+	lua_pop(L, 1);
+
+	lua_newtable(L);
+	lua_pushcfunction(L, &benchmark_run);
+	lua_setfield(L, -2, "run");
+	lua_setfield(L, LUA_GLOBALSINDEX, "benchmark");
+
+	benchmark::print_header();
+
+	int result = 0;
+	std::string script = root + "/benchmark/lua/benchmark.lua";
+	lua_pushcfunction(L, &traceback);
+	if (luaL_loadfile(L, script.c_str()) != 0)
+	{
+		std::fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		result = 1;
+	}
+	else
+	{
+		lua_pushstring(L, ticks);
+		if (lua_pcall(L, 1, 0, -3) != 0)
+		{
+			std::fprintf(stderr, "%s\n", lua_tostring(L, -1));
+			result = 1;
+		}
+	}
+
+	lua_close(L);
+
+	return result;
+}
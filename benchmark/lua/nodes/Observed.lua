@@ -0,0 +1,26 @@
+--------------------------------------------------------------------------------
+-- benchmark/lua/nodes/Observed.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+local B = require "B"
+
+local Observed = B.Node("Observed")
+
+function Observed:activated(mashina, state, executor)
+	-- Nothing.
+end
+
+function Observed:deactivated(mashina, state, executor)
+	-- Nothing.
+end
+
+function Observed:update(mashina, state, executor)
+	return B.Status.Success
+end
+
+return Observed
@@ -0,0 +1,26 @@
+--------------------------------------------------------------------------------
+-- benchmark/lua/nodes/Sequence.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+local B = require "B"
+
+local Sequence = B.Node("Sequence")
+
+function Sequence:update(mashina, state, executor)
+	local children = { self.tree:children(self.node) }
+	for i = 1, #children do
+		local status = executor:update(children[i])
+		if status ~= B.Status.Success then
+			return status
+		end
+	end
+
+	return B.Status.Success
+end
+
+return Sequence
@@ -0,0 +1,18 @@
+--------------------------------------------------------------------------------
+-- benchmark/lua/nodes/Succeed.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+local B = require "B"
+
+local Succeed = B.Node("Succeed")
+
+function Succeed:update(mashina, state, executor)
+	return B.Status.Success
+end
+
+return Succeed
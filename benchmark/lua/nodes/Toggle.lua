@@ -0,0 +1,25 @@
+--------------------------------------------------------------------------------
+-- benchmark/lua/nodes/Toggle.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+local B = require "B"
+
+local Toggle = B.Node("Toggle")
+
+function Toggle:update(mashina, state, executor)
+	local first, second = self.tree:children(self.node)
+
+	self.flipped = not self.flipped
+	if self.flipped then
+		return executor:update(first)
+	else
+		return executor:update(second)
+	end
+end
+
+return Toggle
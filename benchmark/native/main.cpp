@@ -0,0 +1,308 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "counters.hpp"
+
+struct Agent
+{
+	int id = 0;
+
+	bool operator ==(const Agent& other) const
+	{
+		return true;
+	}
+};
+
+#include "bmashina/config.hpp"
+
+static std::atomic<std::size_t> allocator_allocations(0);
+
+namespace bmashina
+{
+	template <>
+	struct Allocator<Agent>
+	{
+		struct Type : public BasicAllocator
+		{
+			Type(Agent& agent)
+			{
+				// Nothing.
+			}
+
+			void* allocate(std::size_t num_bytes) override
+			{
+				++allocator_allocations;
+				return std::malloc(num_bytes);
+			}
+
+			void deallocate(void* value) override
+			{
+				std::free(value);
+			}
+		};
+	};
+}
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/builder/builder.hpp"
+#include "bmashina/primitives/primitives.hpp"
+
+typedef bmashina::BasicTree<Agent> Tree;
+typedef bmashina::BasicNode<Agent> Node;
+typedef bmashina::BasicExecutor<Agent> Executor;
+typedef bmashina::Sequence<Agent> Sequence;
+typedef bmashina::Selector<Agent> Selector;
+typedef bmashina::Invert<Agent> Invert;
+typedef bmashina::Status Status;
+
+class Succeed : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		return Status::success;
+	}
+};
+
+class Fail : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		return Status::failure;
+	}
+};
+
+static const std::size_t NUM_WIRES = 4;
+
+class Wired : public Node
+{
+public:
+	static bmashina::Reference<unsigned> INPUTS[NUM_WIRES];
+	static bmashina::Reference<unsigned> OUTPUTS[NUM_WIRES];
+
+	Status update(Executor& executor) override
+	{
+		auto& state = executor.state();
+
+		// Outputs feed back into the inputs every tick, so the sum grows until
+		// it wraps; unsigned arithmetic keeps that well-defined.
+		unsigned sum = 0;
+		for (auto& input: INPUTS)
+		{
+			sum += state.get(input, 0u);
+		}
+
+		for (std::size_t i = 0; i < NUM_WIRES; ++i)
+		{
+			state.set(OUTPUTS[i], sum + (unsigned)i);
+		}
+
+		return Status::success;
+	}
+};
+
+bmashina::Reference<unsigned> Wired::INPUTS[NUM_WIRES];
+bmashina::Reference<unsigned> Wired::OUTPUTS[NUM_WIRES];
+
+static bmashina::Reference<unsigned> BLACKBOARD[NUM_WIRES];
+
+typedef bmashina::NativeTreeBuilder::NativeTreeBuilderProxy<Agent> Builder;
+
+static std::size_t build_deep_sequence(Tree& tree, std::size_t depth)
+{
+	bmashina::NativeTreeBuilder builder;
+
+	auto current = builder.begin(tree).child<Sequence>();
+	for (std::size_t i = 1; i < depth; ++i)
+	{
+		auto next = current.child<Sequence>();
+		current = next;
+	}
+	current.child<Succeed>();
+
+	return depth + 1;
+}
+
+static std::size_t build_wide_selector(Tree& tree, std::size_t width)
+{
+	bmashina::NativeTreeBuilder builder;
+
+	auto root = builder.begin(tree).child<Selector>();
+	for (std::size_t i = 1; i < width; ++i)
+	{
+		root.child<Fail>();
+	}
+	root.child<Succeed>();
+
+	return width + 1;
+}
+
+static std::size_t build_decorator_chain(Tree& tree, std::size_t length)
+{
+	bmashina::NativeTreeBuilder builder;
+
+	auto current = builder.begin(tree).child<Invert>();
+	for (std::size_t i = 1; i < length; ++i)
+	{
+		auto next = current.child<Invert>();
+		current = next;
+	}
+	current.child<Succeed>();
+
+	return length + 1;
+}
+
+static std::size_t build_heavy_wiring(Tree& tree, std::size_t width)
+{
+	bmashina::NativeTreeBuilder builder;
+
+	auto root = builder.begin(tree).child<Sequence>();
+	for (std::size_t i = 0; i < width; ++i)
+	{
+		auto leaf = root.child<Wired>();
+		for (std::size_t j = 0; j < NUM_WIRES; ++j)
+		{
+			leaf.in(BLACKBOARD[j], Wired::INPUTS[j]);
+			leaf.out(Wired::OUTPUTS[j], BLACKBOARD[j]);
+		}
+	}
+
+	return width + 1;
+}
+
+static std::size_t build_nested_trees(
+	std::vector<std::unique_ptr<Tree>>& trees,
+	Agent& agent,
+	std::size_t depth)
+{
+	for (std::size_t i = 0; i < depth; ++i)
+	{
+		trees.emplace_back(new Tree(agent));
+	}
+
+	for (std::size_t i = depth; i > 0; --i)
+	{
+		bmashina::NativeTreeBuilder builder;
+
+		auto& tree = *trees[i - 1];
+		auto root = builder.begin(tree).child<Sequence>();
+		root.child<Succeed>();
+		if (i < depth)
+		{
+			root.child(*trees[i]);
+		}
+
+		tree.compile();
+	}
+
+	return depth * 3 - 1;
+}
+
+static benchmark::Result run(
+	const char* name,
+	Tree& tree,
+	std::size_t nodes,
+	std::size_t ticks)
+{
+	Agent agent;
+	Executor executor(agent);
+
+	tree.compile();
+
+	// Warm up the executor's frames and state pages before measuring.
+	for (std::size_t i = 0; i < 16; ++i)
+	{
+		tree.execute(executor);
+	}
+
+	benchmark::CacheMissCounter cache_misses;
+	benchmark::Stopwatch stopwatch;
+
+	auto allocations = allocator_allocations.load();
+	auto heap_allocations = benchmark::get_heap_allocations();
+
+	cache_misses.start();
+	stopwatch.start();
+	for (std::size_t i = 0; i < ticks; ++i)
+	{
+		tree.execute(executor);
+	}
+	auto nanoseconds = stopwatch.stop();
+	auto misses = cache_misses.stop();
+
+	allocations = allocator_allocations.load() - allocations;
+	heap_allocations = benchmark::get_heap_allocations() - heap_allocations;
+
+	benchmark::Result result;
+	result.name = name;
+	result.nodes = nodes;
+	result.ticks = ticks;
+	result.nanoseconds_per_tick = nanoseconds / ticks;
+	result.allocations_per_tick = (double)allocations / ticks;
+	result.heap_allocations_per_tick = (double)heap_allocations / ticks;
+	result.cache_misses_per_tick = (double)misses / ticks;
+	result.has_cache_misses = cache_misses.available();
+
+	return result;
+}
+
+int main(int argc, const char* argv[])
+{
+	std::size_t ticks = 100000;
+	if (argc > 1)
+	{
+		ticks = std::strtoul(argv[1], nullptr, 10);
+		if (ticks == 0)
+		{
+			std::fprintf(stderr, "usage: %s [ticks]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Agent agent;
+	benchmark::print_header();
+
+	{
+		Tree tree(agent);
+		auto nodes = build_deep_sequence(tree, 64);
+		benchmark::print_result(run("deep_sequence", tree, nodes, ticks));
+	}
+
+	{
+		Tree tree(agent);
+		auto nodes = build_wide_selector(tree, 256);
+		benchmark::print_result(run("wide_selector", tree, nodes, ticks));
+	}
+
+	{
+		Tree tree(agent);
+		auto nodes = build_decorator_chain(tree, 64);
+		benchmark::print_result(run("decorator_chain", tree, nodes, ticks));
+	}
+
+	{
+		Tree tree(agent);
+		auto nodes = build_heavy_wiring(tree, 32);
+		benchmark::print_result(run("heavy_wiring", tree, nodes, ticks));
+	}
+
+	{
+		std::vector<std::unique_ptr<Tree>> trees;
+		auto nodes = build_nested_trees(trees, agent, 16);
+		benchmark::print_result(run("nested_trees", *trees[0], nodes, ticks));
+	}
+
+	return 0;
+}
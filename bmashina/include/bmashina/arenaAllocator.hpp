@@ -0,0 +1,195 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_ARENA_ALLOCATOR_HPP
+#define BMASHINA_ARENA_ALLOCATOR_HPP
+
+#include <cassert>
+#include <cstddef>
+#include "bmashina/config.hpp"
+
+namespace bmashina
+{
+	// A bump allocator. Allocations are carved out of blocks obtained from
+	// Allocator<M>::Type and are never freed individually; once every
+	// allocation has been deallocated, all blocks but the last are returned
+	// and the last is rewound for reuse.
+	//
+	// Meant for TreeAllocator, e.g.:
+	//
+	//     template <>
+	//     struct bmashina::TreeAllocator<Agent>
+	//     {
+	//         typedef bmashina::ArenaAllocator<Agent> Type;
+	//     };
+	//
+	// Specializing Allocator<M> itself with an arena is not supported, since
+	// the arena gets its blocks from Allocator<M>.
+	template <typename M>
+	class ArenaAllocator : public BasicAllocator
+	{
+	public:
+		typedef M Mashina;
+
+		static constexpr std::size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+
+		ArenaAllocator(Mashina& mashina, std::size_t block_size = DEFAULT_BLOCK_SIZE);
+		ArenaAllocator(const ArenaAllocator& other) = delete;
+		~ArenaAllocator();
+
+		void* allocate(std::size_t num_bytes) override;
+		void deallocate(void* value) override;
+
+		// Number of allocations not yet deallocated.
+		std::size_t get_num_live() const;
+
+		// Number of blocks currently held.
+		std::size_t get_num_blocks() const;
+
+		ArenaAllocator& operator =(const ArenaAllocator& other) = delete;
+
+	private:
+		typedef typename Allocator<Mashina>::Type UpstreamAllocator;
+		UpstreamAllocator upstream;
+
+		struct Block
+		{
+			Block* next;
+			std::size_t size;
+		};
+
+		static constexpr std::size_t ALIGNMENT = alignof(std::max_align_t);
+		static constexpr std::size_t HEADER_SIZE =
+			(sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+		std::size_t block_size;
+		Block* blocks = nullptr;
+		unsigned char* current = nullptr;
+		unsigned char* end = nullptr;
+
+		std::size_t num_live = 0;
+		std::size_t num_blocks = 0;
+
+		void grow(std::size_t num_bytes);
+		void rewind();
+		void release(Block* block);
+	};
+}
+
+template <typename M>
+bmashina::ArenaAllocator<M>::ArenaAllocator(Mashina& mashina, std::size_t block_size) :
+	upstream(mashina),
+	block_size(block_size)
+{
+	// Nothing.
+}
+
+template <typename M>
+bmashina::ArenaAllocator<M>::~ArenaAllocator()
+{
+	assert(num_live == 0);
+	release(blocks);
+}
+
+template <typename M>
+void* bmashina::ArenaAllocator<M>::allocate(std::size_t num_bytes)
+{
+	num_bytes = (num_bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	if (num_bytes == 0)
+	{
+		num_bytes = ALIGNMENT;
+	}
+
+	if (current == nullptr || (std::size_t)(end - current) < num_bytes)
+	{
+		grow(num_bytes);
+	}
+
+	void* result = current;
+	current += num_bytes;
+	++num_live;
+
+	return result;
+}
+
+template <typename M>
+void bmashina::ArenaAllocator<M>::deallocate(void* value)
+{
+	if (value == nullptr)
+	{
+		return;
+	}
+
+	assert(num_live > 0);
+	--num_live;
+
+	if (num_live == 0)
+	{
+		rewind();
+	}
+}
+
+template <typename M>
+std::size_t bmashina::ArenaAllocator<M>::get_num_live() const
+{
+	return num_live;
+}
+
+template <typename M>
+std::size_t bmashina::ArenaAllocator<M>::get_num_blocks() const
+{
+	return num_blocks;
+}
+
+template <typename M>
+void bmashina::ArenaAllocator<M>::grow(std::size_t num_bytes)
+{
+	std::size_t size = num_bytes > block_size ? num_bytes : block_size;
+
+	auto block = static_cast<Block*>(upstream.allocate(HEADER_SIZE + size));
+	assert(block != nullptr);
+
+	block->next = blocks;
+	block->size = size;
+	blocks = block;
+	++num_blocks;
+
+	current = reinterpret_cast<unsigned char*>(block) + HEADER_SIZE;
+	end = current + size;
+}
+
+template <typename M>
+void bmashina::ArenaAllocator<M>::rewind()
+{
+	if (blocks == nullptr)
+	{
+		return;
+	}
+
+	release(blocks->next);
+	blocks->next = nullptr;
+	num_blocks = 1;
+
+	current = reinterpret_cast<unsigned char*>(blocks) + HEADER_SIZE;
+	end = current + blocks->size;
+}
+
+template <typename M>
+void bmashina::ArenaAllocator<M>::release(Block* block)
+{
+	while (block != nullptr)
+	{
+		auto next = block->next;
+		upstream.deallocate(block);
+		block = next;
+
+		--num_blocks;
+	}
+}
+
+#endif
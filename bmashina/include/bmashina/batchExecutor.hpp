@@ -0,0 +1,168 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_BATCH_EXECUTOR_HPP
+#define BMASHINA_BATCH_EXECUTOR_HPP
+
+#include <cassert>
+#include <cstddef>
+#include "bmashina/config.hpp"
+#include "bmashina/executor.hpp"
+#include "bmashina/status.hpp"
+#include "bmashina/tree.hpp"
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+#include <stdexcept>
+#endif
+
+namespace bmashina
+{
+	// Ticks a population of agents, one executor per agent, against a single
+	// shared tree. The tree is compiled once and its structure and wiring are
+	// only read; each agent keeps its own state in its executor. Per-agent
+	// bookkeeping is stored as parallel arrays indexed by agent.
+	//
+	// Agents are ticked one after another, each through the whole tree; this
+	// is a convenience over calling BasicTree::execute in a loop, not
+	// node-major batching. It is not included by bmashina.hpp.
+	template <typename M>
+	class BasicBatchExecutor
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicBatchExecutor<Mashina> BatchExecutor;
+
+		BasicBatchExecutor(Mashina& mashina);
+		BasicBatchExecutor(const BatchExecutor& other) = delete;
+		~BasicBatchExecutor() = default;
+
+		std::size_t add(Executor& executor);
+		void assign(Executor* const* executors, std::size_t count);
+		void clear();
+
+		std::size_t count() const;
+		bool empty() const;
+
+		Executor& executor(std::size_t index) const;
+		Status status(std::size_t index) const;
+		const Status* statuses() const;
+
+		void execute(Tree& tree);
+
+		BatchExecutor& operator =(const BatchExecutor& other) = delete;
+
+	private:
+		typedef Vector<Mashina, Executor*> ExecutorList;
+		typename ExecutorList::Type executors;
+
+		typedef Vector<Mashina, Status> StatusList;
+		typename StatusList::Type results;
+	};
+}
+
+template <typename M>
+bmashina::BasicBatchExecutor<M>::BasicBatchExecutor(Mashina& mashina) :
+	executors(ExecutorList::construct(mashina)),
+	results(StatusList::construct(mashina))
+{
+	// Nothing.
+}
+
+template <typename M>
+std::size_t bmashina::BasicBatchExecutor<M>::add(Executor& executor)
+{
+	auto index = executors.size();
+	executors.push_back(&executor);
+	results.push_back(Status::none);
+
+	return index;
+}
+
+template <typename M>
+void bmashina::BasicBatchExecutor<M>::assign(Executor* const* values, std::size_t count)
+{
+	executors.assign(values, values + count);
+	results.assign(count, Status::none);
+}
+
+template <typename M>
+void bmashina::BasicBatchExecutor<M>::clear()
+{
+	executors.clear();
+	results.clear();
+}
+
+template <typename M>
+std::size_t bmashina::BasicBatchExecutor<M>::count() const
+{
+	return executors.size();
+}
+
+template <typename M>
+bool bmashina::BasicBatchExecutor<M>::empty() const
+{
+	return executors.empty();
+}
+
+template <typename M>
+typename bmashina::BasicBatchExecutor<M>::Executor&
+bmashina::BasicBatchExecutor<M>::executor(std::size_t index) const
+{
+	assert(index < executors.size());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (index >= executors.size())
+	{
+		throw std::out_of_range("agent index out of range");
+	}
+#endif
+
+	return *executors[index];
+}
+
+template <typename M>
+bmashina::Status bmashina::BasicBatchExecutor<M>::status(std::size_t index) const
+{
+	assert(index < results.size());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (index >= results.size())
+	{
+		throw std::out_of_range("agent index out of range");
+	}
+#endif
+
+	return results[index];
+}
+
+template <typename M>
+const bmashina::Status* bmashina::BasicBatchExecutor<M>::statuses() const
+{
+	return results.data();
+}
+
+template <typename M>
+void bmashina::BasicBatchExecutor<M>::execute(Tree& tree)
+{
+	if (!tree.compiled())
+	{
+		tree.compile();
+	}
+
+	auto count = executors.size();
+	auto agents = executors.data();
+	auto output = results.data();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		output[i] = tree.execute(*agents[i]);
+	}
+}
+
+#endif
@@ -9,6 +9,7 @@
 #ifndef BMASHINA_BMASHINA_HPP
 #define BMASHINA_BMASHINA_HPP
 
+#include "bmashina/arenaAllocator.hpp"
 #include "bmashina/channel.hpp"
 #include "bmashina/composite.hpp"
 #include "bmashina/config.hpp"
@@ -17,6 +18,7 @@
 #include "bmashina/node.hpp"
 #include "bmashina/status.hpp"
 #include "bmashina/tree.hpp"
+#include "bmashina/treeInstance.hpp"
 #include "bmashina/state/state.hpp"
 
 #endif
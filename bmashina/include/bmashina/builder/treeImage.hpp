@@ -0,0 +1,939 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_BUILDER_TREE_IMAGE_HPP
+#define BMASHINA_BUILDER_TREE_IMAGE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bmashina/config.hpp"
+#include "bmashina/node.hpp"
+#include "bmashina/tree.hpp"
+#include "bmashina/state/property.hpp"
+#include "bmashina/state/reference.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BMASHINA_TREE_IMAGE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+#include <stdexcept>
+#endif
+
+// A tree image is a flat description of a tree: the dictionary key of every
+// node in preorder, the child span of each node, the input and output wires
+// and any constants wired into the tree. All records are fixed size and
+// every section is 8-byte aligned, so an image mapped into memory is used in
+// place without being parsed.
+//
+// Images are written in the byte order of the host and record it in the
+// header; an image written on a host of the other byte order fails to load.
+//
+// Node construction is deferred until TreeImage::materialize. Keys are
+// looked up in a BasicNodeDictionary and wire endpoints are resolved by name
+// through a caller-provided resolver, so the image holds no pointers.
+//
+// Channels and subtrees are not part of the format; assign them after
+// materializing.
+//
+// An image is recorded through TreeImageWriter, node by node, with the same
+// keys and reference names materialize resolves. A built BasicTree cannot be
+// exported directly: it keeps neither the dictionary key of a node nor the
+// names of the references it is wired with.
+namespace bmashina
+{
+	namespace detail
+	{
+		enum
+		{
+			tree_image_magic = 0x49544d42, // 'BMTI'
+			tree_image_version = 2,
+
+			// Reads as 0x04030201 on a host of the other byte order.
+			tree_image_byte_order = 0x01020304
+		};
+
+		enum
+		{
+			tree_image_constant_number = 1,
+			tree_image_constant_real,
+			tree_image_constant_integer,
+			tree_image_constant_boolean,
+			tree_image_constant_string
+		};
+
+		enum
+		{
+			tree_image_wire_constant = 1 << 0
+		};
+
+		struct TreeImageHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t byte_order;
+			std::uint32_t reserved;
+			std::uint32_t num_nodes;
+			std::uint32_t num_children;
+			std::uint32_t num_wires;
+			std::uint32_t num_constants;
+			std::uint32_t payload_size;
+			std::uint32_t strings_size;
+		};
+
+		struct TreeImageNode
+		{
+			// Offset of the dictionary key in the string section.
+			std::uint32_t key;
+
+			// Ranges into the child and wire sections.
+			std::uint32_t children_begin;
+			std::uint32_t children_end;
+			std::uint32_t inputs_begin;
+			std::uint32_t inputs_end;
+			std::uint32_t outputs_begin;
+			std::uint32_t outputs_end;
+			std::uint32_t reserved;
+		};
+
+		struct TreeImageWire
+		{
+			// String offset of the source reference, or the index of a
+			// constant if tree_image_wire_constant is set.
+			std::uint32_t from;
+
+			// String offset of the destination reference.
+			std::uint32_t to;
+
+			std::uint32_t flags;
+			std::uint32_t reserved;
+		};
+
+		struct TreeImageConstant
+		{
+			std::uint32_t type;
+			std::uint32_t size;
+
+			// Offset of the value in the payload section.
+			std::uint32_t offset;
+			std::uint32_t reserved;
+		};
+
+		template <typename V>
+		struct tree_image_constant_type;
+
+		template <>
+		struct tree_image_constant_type<double> :
+			std::integral_constant<std::uint32_t, tree_image_constant_number> {};
+
+		template <>
+		struct tree_image_constant_type<float> :
+			std::integral_constant<std::uint32_t, tree_image_constant_real> {};
+
+		template <>
+		struct tree_image_constant_type<int> :
+			std::integral_constant<std::uint32_t, tree_image_constant_integer> {};
+
+		template <>
+		struct tree_image_constant_type<bool> :
+			std::integral_constant<std::uint32_t, tree_image_constant_boolean> {};
+
+		template <>
+		struct tree_image_constant_type<std::string> :
+			std::integral_constant<std::uint32_t, tree_image_constant_string> {};
+
+		template <typename V>
+		const unsigned char* tree_image_constant_bytes(const V& value, std::uint32_t& size)
+		{
+			size = (std::uint32_t)sizeof(V);
+			return reinterpret_cast<const unsigned char*>(&value);
+		}
+
+		inline const unsigned char* tree_image_constant_bytes(
+			const std::string& value,
+			std::uint32_t& size)
+		{
+			size = (std::uint32_t)value.size();
+			return reinterpret_cast<const unsigned char*>(value.data());
+		}
+
+		inline std::size_t tree_image_align(std::size_t offset)
+		{
+			return (offset + 7) & ~std::size_t(7);
+		}
+	}
+
+	class TreeImageWriter
+	{
+	public:
+		typedef std::uint32_t NodeID;
+
+		TreeImageWriter() = default;
+		~TreeImageWriter() = default;
+
+		NodeID root(const char* key);
+		NodeID child(NodeID parent, const char* key);
+
+		void input(NodeID node, const char* from, const char* to);
+		void output(NodeID node, const char* from, const char* to);
+
+		// Wires a constant into 'to' on node.
+		template <typename V>
+		void constant(NodeID node, const V& value, const char* to);
+
+		void clear();
+		bool empty() const;
+
+		void write(std::vector<unsigned char>& result) const;
+		bool save(const char* filename) const;
+
+	private:
+		struct Wire
+		{
+			std::uint32_t from;
+			std::uint32_t to;
+			std::uint32_t flags;
+		};
+
+		struct Node
+		{
+			std::uint32_t key;
+			std::vector<NodeID> children;
+			std::vector<Wire> inputs;
+			std::vector<Wire> outputs;
+		};
+		std::vector<Node> nodes;
+		std::vector<detail::TreeImageConstant> constants;
+		std::vector<unsigned char> payload;
+		std::vector<char> strings;
+
+		std::uint32_t intern(const char* value);
+		Node& get(NodeID node);
+	};
+
+	class TreeImage
+	{
+	public:
+		TreeImage() = default;
+		TreeImage(const TreeImage& other) = delete;
+		~TreeImage();
+
+		// Maps the file into memory. Falls back to reading the file into a
+		// buffer on platforms without mmap.
+		bool open(const char* filename);
+
+		// Uses the image in data. The image does not take ownership; data
+		// must remain valid until the image is closed.
+		bool load(const void* data, std::size_t size);
+
+		void close();
+		bool valid() const;
+
+		std::size_t size() const;
+		std::size_t get_num_nodes() const;
+		const char* get_key(std::size_t node) const;
+
+		// Constructs the tree described by the image into tree, replacing
+		// any existing nodes.
+		//
+		// Node keys are converted to dictionary keys with Key(const char*).
+		// resolver is called as resolver(name) for every wire endpoint and
+		// must return a pointer to a detail::BaseReference that outlives the
+		// tree.
+		template <typename M, typename D, typename R>
+		void materialize(BasicTree<M>& tree, const D& dictionary, R&& resolver) const;
+
+		TreeImage& operator =(const TreeImage& other) = delete;
+
+	private:
+		const unsigned char* data = nullptr;
+		std::size_t data_size = 0;
+
+		enum
+		{
+			storage_none,
+			storage_borrowed,
+			storage_mapped,
+			storage_buffer
+		};
+		int storage = storage_none;
+
+		const detail::TreeImageHeader* header = nullptr;
+		const detail::TreeImageNode* nodes = nullptr;
+		const std::uint32_t* children = nullptr;
+		const detail::TreeImageWire* wires = nullptr;
+		const detail::TreeImageConstant* constants = nullptr;
+		const unsigned char* payload = nullptr;
+		const char* strings = nullptr;
+
+		bool validate();
+		const char* get_string(std::uint32_t offset) const;
+
+		template <typename M, typename V>
+		const detail::BaseReference& make_constant(
+			BasicTree<M>& tree,
+			const detail::TreeImageConstant& constant) const;
+		template <typename M>
+		const detail::BaseReference& make_constant(
+			BasicTree<M>& tree,
+			const detail::TreeImageConstant& constant) const;
+	};
+}
+
+inline bmashina::TreeImageWriter::NodeID
+bmashina::TreeImageWriter::root(const char* key)
+{
+	assert(nodes.empty());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (!nodes.empty())
+	{
+		throw std::runtime_error("tree image already has root");
+	}
+#endif
+
+	Node node;
+	node.key = intern(key);
+	nodes.push_back(std::move(node));
+
+	return 0;
+}
+
+inline bmashina::TreeImageWriter::NodeID
+bmashina::TreeImageWriter::child(NodeID parent, const char* key)
+{
+	get(parent);
+
+	Node node;
+	node.key = intern(key);
+	nodes.push_back(std::move(node));
+
+	NodeID result = (NodeID)(nodes.size() - 1);
+	get(parent).children.push_back(result);
+
+	return result;
+}
+
+inline void bmashina::TreeImageWriter::input(
+	NodeID node,
+	const char* from,
+	const char* to)
+{
+	get(node).inputs.push_back({ intern(from), intern(to), 0 });
+}
+
+inline void bmashina::TreeImageWriter::output(
+	NodeID node,
+	const char* from,
+	const char* to)
+{
+	get(node).outputs.push_back({ intern(from), intern(to), 0 });
+}
+
+template <typename V>
+void bmashina::TreeImageWriter::constant(
+	NodeID node,
+	const V& value,
+	const char* to)
+{
+	typedef detail::tree_image_constant_type<V> Type;
+
+	detail::TreeImageConstant constant = {};
+	constant.type = Type::value;
+	constant.offset = (std::uint32_t)detail::tree_image_align(payload.size());
+
+	const unsigned char* bytes = detail::tree_image_constant_bytes(value, constant.size);
+
+	payload.resize(constant.offset);
+	payload.insert(payload.end(), bytes, bytes + constant.size);
+
+	get(node).inputs.push_back({
+		(std::uint32_t)constants.size(),
+		intern(to),
+		detail::tree_image_wire_constant
+	});
+	constants.push_back(constant);
+}
+
+inline void bmashina::TreeImageWriter::clear()
+{
+	nodes.clear();
+	constants.clear();
+	payload.clear();
+	strings.clear();
+}
+
+inline bool bmashina::TreeImageWriter::empty() const
+{
+	return nodes.empty();
+}
+
+inline void bmashina::TreeImageWriter::write(std::vector<unsigned char>& result) const
+{
+	assert(!nodes.empty());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (nodes.empty())
+	{
+		throw std::runtime_error("tree image has no root");
+	}
+#endif
+
+	// Nodes are stored in preorder, so the children of a node are always
+	// constructed after their parent.
+	std::vector<NodeID> order;
+	std::vector<std::uint32_t> ordinals(nodes.size());
+	std::vector<NodeID> pending(1, 0);
+	while (!pending.empty())
+	{
+		NodeID current = pending.back();
+		pending.pop_back();
+
+		ordinals[current] = (std::uint32_t)order.size();
+		order.push_back(current);
+
+		auto& children = nodes[current].children;
+		pending.insert(pending.end(), children.rbegin(), children.rend());
+	}
+
+	std::vector<detail::TreeImageNode> image_nodes;
+	std::vector<std::uint32_t> image_children;
+	std::vector<detail::TreeImageWire> image_wires;
+	for (auto index: order)
+	{
+		auto& node = nodes[index];
+
+		detail::TreeImageNode image_node = {};
+		image_node.key = node.key;
+
+		image_node.children_begin = (std::uint32_t)image_children.size();
+		for (auto child: node.children)
+		{
+			image_children.push_back(ordinals[child]);
+		}
+		image_node.children_end = (std::uint32_t)image_children.size();
+
+		image_node.inputs_begin = (std::uint32_t)image_wires.size();
+		for (auto& wire: node.inputs)
+		{
+			image_wires.push_back({ wire.from, wire.to, wire.flags, 0 });
+		}
+		image_node.inputs_end = (std::uint32_t)image_wires.size();
+
+		image_node.outputs_begin = (std::uint32_t)image_wires.size();
+		for (auto& wire: node.outputs)
+		{
+			image_wires.push_back({ wire.from, wire.to, wire.flags, 0 });
+		}
+		image_node.outputs_end = (std::uint32_t)image_wires.size();
+
+		image_nodes.push_back(image_node);
+	}
+
+	detail::TreeImageHeader header = {};
+	header.magic = detail::tree_image_magic;
+	header.version = detail::tree_image_version;
+	header.byte_order = detail::tree_image_byte_order;
+	header.num_nodes = (std::uint32_t)image_nodes.size();
+	header.num_children = (std::uint32_t)image_children.size();
+	header.num_wires = (std::uint32_t)image_wires.size();
+	header.num_constants = (std::uint32_t)constants.size();
+	header.payload_size = (std::uint32_t)payload.size();
+	header.strings_size = (std::uint32_t)strings.size();
+
+	result.clear();
+	auto append = [&result](const void* data, std::size_t size)
+	{
+		result.resize(detail::tree_image_align(result.size()));
+
+		auto bytes = static_cast<const unsigned char*>(data);
+		result.insert(result.end(), bytes, bytes + size);
+	};
+	append(&header, sizeof(header));
+	append(image_nodes.data(), image_nodes.size() * sizeof(detail::TreeImageNode));
+	append(image_children.data(), image_children.size() * sizeof(std::uint32_t));
+	append(image_wires.data(), image_wires.size() * sizeof(detail::TreeImageWire));
+	append(constants.data(), constants.size() * sizeof(detail::TreeImageConstant));
+	append(payload.data(), payload.size());
+	append(strings.data(), strings.size());
+}
+
+inline bool bmashina::TreeImageWriter::save(const char* filename) const
+{
+	std::vector<unsigned char> result;
+	write(result);
+
+	std::FILE* file = std::fopen(filename, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool success = std::fwrite(result.data(), 1, result.size(), file) == result.size();
+	success = (std::fclose(file) == 0) && success;
+
+	return success;
+}
+
+inline std::uint32_t bmashina::TreeImageWriter::intern(const char* value)
+{
+	assert(value != nullptr);
+
+	std::size_t length = std::strlen(value);
+	for (std::size_t i = 0; i < strings.size(); i += std::strlen(&strings[i]) + 1)
+	{
+		if (std::strcmp(&strings[i], value) == 0)
+		{
+			return (std::uint32_t)i;
+		}
+	}
+
+	auto result = (std::uint32_t)strings.size();
+	strings.insert(strings.end(), value, value + length + 1);
+
+	return result;
+}
+
+inline bmashina::TreeImageWriter::Node&
+bmashina::TreeImageWriter::get(NodeID node)
+{
+	assert(node < nodes.size());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (node >= nodes.size())
+	{
+		throw std::runtime_error("node not in tree image");
+	}
+#endif
+
+	return nodes[node];
+}
+
+inline bmashina::TreeImage::~TreeImage()
+{
+	close();
+}
+
+inline bool bmashina::TreeImage::open(const char* filename)
+{
+	close();
+
+#ifdef BMASHINA_TREE_IMAGE_MMAP
+	int file = ::open(filename, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (::fstat(file, &status) != 0 || status.st_size <= 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	void* mapping = ::mmap(nullptr, (std::size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<const unsigned char*>(mapping);
+	data_size = (std::size_t)status.st_size;
+	storage = storage_mapped;
+#else
+	std::FILE* file = std::fopen(filename, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	std::fseek(file, 0, SEEK_END);
+	long length = std::ftell(file);
+	std::fseek(file, 0, SEEK_SET);
+
+	void* buffer = nullptr;
+	if (length > 0)
+	{
+		buffer = std::malloc((std::size_t)length);
+	}
+
+	if (buffer == nullptr ||
+		std::fread(buffer, 1, (std::size_t)length, file) != (std::size_t)length)
+	{
+		std::free(buffer);
+		std::fclose(file);
+		return false;
+	}
+	std::fclose(file);
+
+	data = static_cast<const unsigned char*>(buffer);
+	data_size = (std::size_t)length;
+	storage = storage_buffer;
+#endif
+
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+inline bool bmashina::TreeImage::load(const void* data, std::size_t size)
+{
+	close();
+
+	this->data = static_cast<const unsigned char*>(data);
+	this->data_size = size;
+	storage = storage_borrowed;
+
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+inline void bmashina::TreeImage::close()
+{
+#ifdef BMASHINA_TREE_IMAGE_MMAP
+	if (storage == storage_mapped)
+	{
+		::munmap(const_cast<unsigned char*>(data), data_size);
+	}
+#endif
+
+	if (storage == storage_buffer)
+	{
+		std::free(const_cast<unsigned char*>(data));
+	}
+
+	data = nullptr;
+	data_size = 0;
+	storage = storage_none;
+
+	header = nullptr;
+	nodes = nullptr;
+	children = nullptr;
+	wires = nullptr;
+	constants = nullptr;
+	payload = nullptr;
+	strings = nullptr;
+}
+
+inline bool bmashina::TreeImage::valid() const
+{
+	return header != nullptr;
+}
+
+inline std::size_t bmashina::TreeImage::size() const
+{
+	return data_size;
+}
+
+inline std::size_t bmashina::TreeImage::get_num_nodes() const
+{
+	if (header == nullptr)
+	{
+		return 0;
+	}
+
+	return header->num_nodes;
+}
+
+inline const char* bmashina::TreeImage::get_key(std::size_t node) const
+{
+	assert(node < get_num_nodes());
+	return get_string(nodes[node].key);
+}
+
+template <typename M, typename D, typename R>
+void bmashina::TreeImage::materialize(
+	BasicTree<M>& tree,
+	const D& dictionary,
+	R&& resolver) const
+{
+	typedef typename D::Key Key;
+	typedef BasicNode<M> Node;
+
+	assert(valid());
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (!valid())
+	{
+		throw std::runtime_error("tree image not loaded");
+	}
+#endif
+
+	tree.clear();
+
+	std::vector<Node*> instances(header->num_nodes, nullptr);
+	instances[0] = &dictionary.get(Key(get_key(0))).construct(tree);
+	for (std::size_t i = 0; i < header->num_nodes; ++i)
+	{
+		auto& node = nodes[i];
+		for (auto j = node.children_begin; j < node.children_end; ++j)
+		{
+			auto child = children[j];
+			instances[child] = &dictionary.get(Key(get_key(child))).construct(tree, *instances[i]);
+		}
+	}
+
+	std::vector<const detail::BaseReference*> values(header->num_constants, nullptr);
+	for (std::size_t i = 0; i < header->num_constants; ++i)
+	{
+		values[i] = &make_constant(tree, constants[i]);
+	}
+
+	auto resolve = [&resolver](const char* name) -> const detail::BaseReference&
+	{
+		const detail::BaseReference* reference = resolver(name);
+		assert(reference != nullptr);
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+		if (reference == nullptr)
+		{
+			throw std::runtime_error("could not resolve tree image reference");
+		}
+#endif
+
+		return *reference;
+	};
+
+	for (std::size_t i = 0; i < header->num_nodes; ++i)
+	{
+		auto& node = nodes[i];
+		for (auto j = node.inputs_begin; j < node.inputs_end; ++j)
+		{
+			auto& wire = wires[j];
+			auto& to = resolve(get_string(wire.to));
+			if (wire.flags & detail::tree_image_wire_constant)
+			{
+				tree.input(*instances[i], *values[wire.from], to);
+			}
+			else
+			{
+				tree.input(*instances[i], resolve(get_string(wire.from)), to);
+			}
+		}
+
+		for (auto j = node.outputs_begin; j < node.outputs_end; ++j)
+		{
+			auto& wire = wires[j];
+			tree.output(
+				*instances[i],
+				resolve(get_string(wire.from)),
+				resolve(get_string(wire.to)));
+		}
+	}
+
+	tree.compile();
+}
+
+inline bool bmashina::TreeImage::validate()
+{
+	// Records are read in place, so the image must be at least as aligned as
+	// the sections within it.
+	if (data == nullptr ||
+		data_size < sizeof(detail::TreeImageHeader) ||
+		reinterpret_cast<std::uintptr_t>(data) % 8 != 0)
+	{
+		return false;
+	}
+
+	auto image_header = reinterpret_cast<const detail::TreeImageHeader*>(data);
+	if (image_header->magic != detail::tree_image_magic ||
+		image_header->version != detail::tree_image_version ||
+		image_header->byte_order != detail::tree_image_byte_order ||
+		image_header->num_nodes == 0)
+	{
+		return false;
+	}
+
+	std::size_t offset = 0;
+	bool overflow = false;
+	auto section = [&](std::size_t count, std::size_t size) -> const unsigned char*
+	{
+		offset = detail::tree_image_align(offset);
+		if (offset > data_size || count > (data_size - offset) / size)
+		{
+			overflow = true;
+			return nullptr;
+		}
+
+		auto result = data + offset;
+		offset += count * size;
+
+		return result;
+	};
+
+	section(1, sizeof(detail::TreeImageHeader));
+	auto image_nodes = section(image_header->num_nodes, sizeof(detail::TreeImageNode));
+	auto image_children = section(image_header->num_children, sizeof(std::uint32_t));
+	auto image_wires = section(image_header->num_wires, sizeof(detail::TreeImageWire));
+	auto image_constants = section(image_header->num_constants, sizeof(detail::TreeImageConstant));
+	auto image_payload = section(image_header->payload_size, 1);
+	auto image_strings = section(image_header->strings_size, 1);
+	if (overflow ||
+		image_header->strings_size == 0 ||
+		image_strings[image_header->strings_size - 1] != 0)
+	{
+		return false;
+	}
+
+	header = image_header;
+	nodes = reinterpret_cast<const detail::TreeImageNode*>(image_nodes);
+	children = reinterpret_cast<const std::uint32_t*>(image_children);
+	wires = reinterpret_cast<const detail::TreeImageWire*>(image_wires);
+	constants = reinterpret_cast<const detail::TreeImageConstant*>(image_constants);
+	payload = image_payload;
+	strings = reinterpret_cast<const char*>(image_strings);
+
+	// Bounds are checked once here so materialize can index freely. Children
+	// must come after their parent, which also rules out cycles, and every
+	// node but the root must have exactly one parent.
+	std::vector<std::uint8_t> parents(header->num_nodes, 0);
+	for (std::uint32_t i = 0; i < header->num_nodes; ++i)
+	{
+		auto& node = nodes[i];
+		if (node.key >= header->strings_size ||
+			node.children_begin > node.children_end ||
+			node.children_end > header->num_children ||
+			node.inputs_begin > node.inputs_end ||
+			node.inputs_end > node.outputs_begin ||
+			node.outputs_begin > node.outputs_end ||
+			node.outputs_end > header->num_wires)
+		{
+			header = nullptr;
+			return false;
+		}
+
+		for (auto j = node.children_begin; j < node.children_end; ++j)
+		{
+			if (children[j] <= i || children[j] >= header->num_nodes ||
+				parents[children[j]] != 0)
+			{
+				header = nullptr;
+				return false;
+			}
+
+			parents[children[j]] = 1;
+		}
+	}
+
+	for (std::uint32_t i = 1; i < header->num_nodes; ++i)
+	{
+		if (parents[i] == 0)
+		{
+			header = nullptr;
+			return false;
+		}
+	}
+
+	for (std::uint32_t i = 0; i < header->num_wires; ++i)
+	{
+		auto& wire = wires[i];
+		bool is_constant = (wire.flags & detail::tree_image_wire_constant) != 0;
+		if ((is_constant && wire.from >= header->num_constants) ||
+			(!is_constant && wire.from >= header->strings_size) ||
+			wire.to >= header->strings_size)
+		{
+			header = nullptr;
+			return false;
+		}
+	}
+
+	for (std::uint32_t i = 0; i < header->num_constants; ++i)
+	{
+		auto& constant = constants[i];
+		if (constant.offset > header->payload_size ||
+			constant.size > header->payload_size - constant.offset)
+		{
+			header = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+inline const char* bmashina::TreeImage::get_string(std::uint32_t offset) const
+{
+	assert(offset < header->strings_size);
+	return strings + offset;
+}
+
+template <typename M, typename V>
+const bmashina::detail::BaseReference& bmashina::TreeImage::make_constant(
+	BasicTree<M>& tree,
+	const detail::TreeImageConstant& constant) const
+{
+	assert(constant.size == sizeof(V));
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (constant.size != sizeof(V))
+	{
+		throw std::runtime_error("tree image constant has wrong size");
+	}
+#endif
+
+	// The payload is only 8-byte aligned relative to the image.
+	V value;
+	std::memcpy(&value, payload + constant.offset, sizeof(V));
+
+	return tree.constant(Property<V>(value));
+}
+
+template <typename M>
+const bmashina::detail::BaseReference& bmashina::TreeImage::make_constant(
+	BasicTree<M>& tree,
+	const detail::TreeImageConstant& constant) const
+{
+	switch (constant.type)
+	{
+		case detail::tree_image_constant_number:
+			return make_constant<M, double>(tree, constant);
+		case detail::tree_image_constant_real:
+			return make_constant<M, float>(tree, constant);
+		case detail::tree_image_constant_integer:
+			return make_constant<M, int>(tree, constant);
+		case detail::tree_image_constant_boolean:
+			return make_constant<M, bool>(tree, constant);
+		case detail::tree_image_constant_string:
+			{
+				auto begin = reinterpret_cast<const char*>(payload + constant.offset);
+				return tree.constant(Property<std::string>(std::string(begin, constant.size)));
+			}
+	}
+
+	assert(false);
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	throw std::runtime_error("tree image constant has unknown type");
+#else
+	std::abort();
+#endif
+}
+
+#endif
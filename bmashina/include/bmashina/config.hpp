@@ -9,6 +9,7 @@
 #ifndef BMASHINA_CONFIG_HPP
 #define BMASHINA_CONFIG_HPP
 
+#include <cassert>
 #include <type_traits>
 
 #ifndef BMASHINA_DISABLE_STL_CONTAINERS
@@ -147,6 +148,46 @@ namespace bmashina
 			void* allocate(std::size_t num_bytes) override;
 			void deallocate(void* value) override;
 		};
+#endif
+	};
+
+	// Allocator for the nodes and references owned by a BasicTree. These are
+	// created together when a tree is built and destroyed together by
+	// BasicTree::clear, so an ArenaAllocator is a good fit.
+	template <typename M>
+	struct TreeAllocator
+	{
+		typedef typename Allocator<M>::Type Type;
+	};
+
+	template <typename M>
+	class ArenaAllocator;
+
+	// Allocator for state values that only live for one tick, such as the
+	// copies made for input wires. Each BasicExecutor owns one. The default
+	// arena rewinds whenever every value allocated from it has been freed,
+	// which is normally once the outermost tree returns.
+	template <typename M>
+	struct ScratchAllocator
+	{
+		typedef ArenaAllocator<M> Type;
+	};
+
+	template <typename M>
+	class NullTracer;
+
+	template <typename M>
+	class PreviewTracer;
+
+	// Receives executor events; see NullTracer. Defaults to PreviewTracer, or
+	// to NullTracer (which compiles away) if BMASHINA_DISABLE_DEBUG is set.
+	template <typename M>
+	struct Tracer
+	{
+#ifdef BMASHINA_DISABLE_DEBUG
+		typedef NullTracer<M> Type;
+#else
+		typedef PreviewTracer<M> Type;
 #endif
 	};
 }
@@ -12,9 +12,11 @@
 #include <utility>
 #include <cassert>
 #include <cstddef>
+#include "bmashina/arenaAllocator.hpp"
 #include "bmashina/config.hpp"
 #include "bmashina/node.hpp"
 #include "bmashina/status.hpp"
+#include "bmashina/tracer.hpp"
 #include "bmashina/state/state.hpp"
 
 #ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
@@ -26,12 +28,16 @@ namespace bmashina
 	template <typename M>
 	class BasicTree;
 
+	template <typename M>
+	class BasicTreeInstance;
+
 	template <typename M>
 	class BasicExecutor
 	{
 	public:
 		typedef M Mashina;
 		typedef BasicTree<Mashina> Tree;
+		typedef BasicTreeInstance<Mashina> Instance;
 		typedef BasicNode<Mashina> Node;
 		typedef BasicState<Mashina> State;
 		typedef BasicExecutor<Mashina> Executor;
@@ -44,33 +50,61 @@ namespace bmashina
 
 		void reset();
 
-		void enter(Tree& tree);
+		void enter(Tree& tree, const Instance* instance = nullptr);
 		void leave(Tree& tree);
 
+		// The instance the current tree is executing on behalf of, if any.
+		const Instance* get_instance() const;
+
 		void enter(Node& node);
 		void leave(Node& node, Status status);
 		Status update(Node& node);
 		void visit(Node& node);
 		void drop();
 
+		bool is_active(const Node& node);
+		void set_active(const Node& node, bool value);
+
+		// Lets a composite continue from a child across ticks. suspend records
+		// the child index for the current node; resume moves the current frame
+		// to that child and returns its index. The record is forgotten when
+		// the node's frame is dropped.
+		std::size_t resume();
+		void suspend(std::size_t index);
+
+		// Event-driven execution. While enabled, ticking the same tree again is
+		// skipped (and returns working) if the last tick returned working, every
+		// node left working watched at least one reference, and no watched
+		// reference has changed in state() since it was watched. Nodes that
+		// return working without watching anything keep the tree ticking.
+		void set_event_driven(bool value);
+		bool get_event_driven() const;
+
+		// Wakes the executor when the value of reference changes. Watching a
+		// wired input of the current node watches the reference it is wired
+		// from.
+		void watch(const detail::BaseReference& reference);
+
+		// True if ticking tree can be skipped. Checked by BasicTree::execute.
+		bool sleeping(const Tree& tree, const Instance* instance = nullptr) const;
+
+		// Frames allocated and reused since the current (or last) tick began.
+		std::size_t get_frames_allocated() const;
+		std::size_t get_frames_reused() const;
+
 		Mashina* operator ->();
 		Mashina& operator *();
 
-#ifndef BMASHINA_DISABLE_DEBUG
-		class Preview
-		{
-		public:
-			virtual void before_enter_tree(Tree* tree) = 0;
-			virtual void after_enter_tree(Tree* tree) = 0;
-			virtual void before_leave_tree(Tree* tree) = 0;
-			virtual void after_leave_tree(Tree* tree) = 0;
-			virtual void before_update_node(Node& node) = 0;
-			virtual void after_update_node(Node& node, Status status) = 0;
-		};
-
 		std::size_t get_current_depth() const;
 		std::size_t get_current_index() const;
 
+		typedef typename Tracer<Mashina>::Type TracerType;
+		TracerType& get_tracer();
+
+#ifndef BMASHINA_DISABLE_DEBUG
+		typedef BasicPreview<Mashina> Preview;
+
+		// Only available with the default PreviewTracer.
 		void set_preview(Preview* value);
 #endif
 
@@ -84,37 +118,77 @@ namespace bmashina
 		{
 			StateFrame(
 				Executor& executor,
-				AllocatorType& allocator,
 				Tree* tree,
 				Node* node,
 				StateFrame* parent = nullptr);
-			~StateFrame();
+			~StateFrame() = default;
 
 			Executor* executor;
-			AllocatorType* allocator;
 			StateFrame* parent;
 			Tree* tree;
 			Node* node;
 			std::size_t index = 0;
+			std::size_t resume = 0;
+			std::size_t watches = 0;
+			const Instance* instance = nullptr;
+			const State* constants = nullptr;
+
+			// Locals scope in root_state; shared by a tree frame and the
+			// frames of its nodes.
+			std::size_t scope = 0;
 
 			void shrink(std::size_t new_index);
 
 			typedef Vector<Mashina, StateFrame*> Children;
 			typename Children::Type children;
 		};
+		typedef typename ScratchAllocator<Mashina>::Type ScratchAllocatorType;
+		ScratchAllocatorType scratch_allocator;
+
 		State root_state;
 		StateFrame* frames = nullptr;
 		StateFrame* current_frame = nullptr;
 
+		// Activation of nodes, tracked per tree and indexed by node ordinal.
+		typedef Vector<Mashina, bool> ActiveNodes;
+		typedef UnorderedMap<Mashina, const Tree*, typename ActiveNodes::Type> ActiveNodesByTree;
+		typename ActiveNodesByTree::Type active_nodes;
+		const Tree* active_tree = nullptr;
+		typename ActiveNodes::Type* active_tree_nodes = nullptr;
+
+		typename ActiveNodes::Type& get_active_nodes(const Tree& tree);
+		void invalidate_active_nodes(const Tree& tree);
+
 		void push_frame(Tree& tree, Node* node = nullptr);
 		void leave_frame(Tree& tree, Node* node = nullptr);
 		StateFrame* new_frame(Tree& tree, Node* node);
+		void release_frame(StateFrame* frame);
+
+		// Released frames are kept, along with their child lists, and handed
+		// out again by new_frame.
+		typedef Vector<Mashina, StateFrame*> FrameList;
+		typename FrameList::Type free_frames;
+		std::size_t frames_allocated = 0;
+		std::size_t frames_reused = 0;
 
 		std::size_t current_depth = 0;
 
-#ifndef BMASHINA_DISABLE_DEBUG
-		Preview* preview = nullptr;
-#endif
+		// Slots watched during the last tick, with their revisions at the time.
+		struct Watch
+		{
+			std::size_t slot;
+			std::size_t revision;
+		};
+
+		typedef Vector<Mashina, Watch> WatchList;
+		typename WatchList::Type watches;
+		bool event_driven = false;
+		bool restless = false;
+		const Tree* last_tree = nullptr;
+		const Instance* last_instance = nullptr;
+		Status last_status = Status::none;
+
+		TracerType tracer;
 	};
 }
 
@@ -122,11 +196,16 @@ template <typename M>
 bmashina::BasicExecutor<M>::BasicExecutor(Mashina& mashina) :
 	mashina_instance(mashina),
 	allocator(mashina),
+	scratch_allocator(mashina),
 	root_state(mashina),
-	frames(BasicAllocator::create<StateFrame>(allocator, *this, allocator, nullptr, nullptr)),
-	current_frame(frames)
+	frames(BasicAllocator::create<StateFrame>(allocator, *this, nullptr, nullptr)),
+	current_frame(frames),
+	active_nodes(ActiveNodesByTree::construct(mashina)),
+	free_frames(FrameList::construct(mashina)),
+	watches(WatchList::construct(mashina)),
+	tracer(mashina)
 {
-	// Nothing.
+	root_state.set_scratch_allocator(&scratch_allocator);
 }
 
 template <typename M>
@@ -134,6 +213,11 @@ bmashina::BasicExecutor<M>::~BasicExecutor()
 {
 	reset();
 	BasicAllocator::destroy(allocator, frames);
+
+	for (auto frame: free_frames)
+	{
+		BasicAllocator::destroy(allocator, frame);
+	}
 }
 
 template <typename M>
@@ -158,26 +242,50 @@ void bmashina::BasicExecutor<M>::reset()
 	frames->shrink(0);
 	current_frame = frames;
 	root_state.clear();
+	root_state.set_fallback(nullptr);
+
+	for (auto& i: active_nodes)
+	{
+		i.second.clear();
+	}
+
+	watches.clear();
+	restless = false;
+	last_tree = nullptr;
+	last_instance = nullptr;
+	last_status = Status::none;
 }
 
 template <typename M>
-void bmashina::BasicExecutor<M>::enter(Tree& tree)
+void bmashina::BasicExecutor<M>::enter(Tree& tree, const Instance* instance)
 {
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
+	if (current_depth == 0)
 	{
-		preview->before_enter_tree(current_frame->tree);
+		frames_allocated = 0;
+		frames_reused = 0;
+
+		watches.clear();
+		restless = false;
+		last_tree = &tree;
+		last_instance = instance;
+		last_status = Status::none;
 	}
-#endif
 
-	push_frame(tree);
+	tracer.before_enter_tree(*this, current_frame->tree);
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
+	push_frame(tree);
+	current_frame->instance = instance;
+	if (instance != nullptr)
 	{
-		preview->after_enter_tree(&tree);
+		current_frame->constants = &instance->get_constants();
 	}
-#endif
+	else
+	{
+		current_frame->constants = &tree.get_constants();
+	}
+	root_state.set_fallback(current_frame->constants);
+
+	tracer.after_enter_tree(*this, &tree);
 }
 
 template <typename M>
@@ -192,21 +300,12 @@ void bmashina::BasicExecutor<M>::leave(Tree& tree)
 	}
 #endif
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
-	{
-		preview->before_leave_tree(&tree);
-	}
-#endif
+	tracer.before_leave_tree(*this, &tree);
 
 	leave_frame(tree);
+	root_state.set_fallback(current_frame->constants);
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
-	{
-		preview->after_leave_tree(current_frame->tree);
-	}
-#endif
+	tracer.after_leave_tree(*this, current_frame->tree);
 }
 
 template <typename M>
@@ -214,27 +313,36 @@ void bmashina::BasicExecutor<M>::enter(Node& node)
 {
 	assert(current_depth > 0);
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
-	{
-		preview->before_update_node(node);
-	}
-#endif
+	tracer.before_update_node(*this, node);
 
 	push_frame(*current_frame->tree, &node);
+	current_frame->instance = current_frame->parent->instance;
+	current_frame->constants = current_frame->parent->constants;
+}
+
+template <typename M>
+const typename bmashina::BasicExecutor<M>::Instance*
+bmashina::BasicExecutor<M>::get_instance() const
+{
+	return current_frame->instance;
 }
 
 template <typename M>
 void bmashina::BasicExecutor<M>::leave(Node& node, Status status)
 {
-	leave_frame(*current_frame->tree, &node);
+	if (status == Status::working && current_frame->watches == watches.size())
+	{
+		restless = true;
+	}
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	if (preview != nullptr)
+	if (current_frame->parent->parent == frames)
 	{
-		preview->after_update_node(node, status);
+		last_status = status;
 	}
-#endif
+
+	leave_frame(*current_frame->tree, &node);
+
+	tracer.after_update_node(*this, node, status);
 }
 
 template <typename M>
@@ -278,6 +386,156 @@ void bmashina::BasicExecutor<M>::drop()
 	}
 }
 
+template <typename M>
+bool bmashina::BasicExecutor<M>::is_active(const Node& node)
+{
+	auto& nodes = get_active_nodes(node.tree());
+	auto ordinal = node.ordinal();
+
+	return ordinal < nodes.size() && nodes[ordinal];
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::set_active(const Node& node, bool value)
+{
+	auto& nodes = get_active_nodes(node.tree());
+	auto ordinal = node.ordinal();
+
+	if (ordinal >= nodes.size())
+	{
+		if (!value)
+		{
+			return;
+		}
+
+		nodes.resize(ordinal + 1, false);
+	}
+
+	if (nodes[ordinal] != value)
+	{
+		nodes[ordinal] = value;
+
+		if (value)
+		{
+			tracer.activated_node(*this, node);
+		}
+		else
+		{
+			tracer.deactivated_node(*this, node);
+		}
+	}
+}
+
+template <typename M>
+std::size_t bmashina::BasicExecutor<M>::resume()
+{
+	assert(current_depth > 0);
+
+	auto index = current_frame->resume;
+	if (index > current_frame->children.size())
+	{
+		index = current_frame->children.size();
+	}
+
+	current_frame->index = index;
+	return index;
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::suspend(std::size_t index)
+{
+	assert(current_depth > 0);
+	current_frame->resume = index;
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::set_event_driven(bool value)
+{
+	event_driven = value;
+}
+
+template <typename M>
+bool bmashina::BasicExecutor<M>::get_event_driven() const
+{
+	return event_driven;
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::watch(const detail::BaseReference& reference)
+{
+	if (!event_driven)
+	{
+		return;
+	}
+
+	// Wired inputs are copied in and unset around every update, so their
+	// revision always changes. Watch what they were wired from instead,
+	// following the wire out through enclosing nodes and trees.
+	auto source = &reference;
+	for (auto frame = current_frame; frame != nullptr; frame = frame->parent)
+	{
+		if (frame->node != nullptr)
+		{
+			source = &frame->tree->get_input_source(*frame->node, *source);
+		}
+	}
+
+	watches.push_back({ source->slot, root_state.get_revision(*source) });
+}
+
+template <typename M>
+bool bmashina::BasicExecutor<M>::sleeping(const Tree& tree, const Instance* instance) const
+{
+	if (!event_driven || current_depth != 0)
+	{
+		return false;
+	}
+
+	if (last_tree != &tree || last_instance != instance || last_status != Status::working || restless || watches.empty())
+	{
+		return false;
+	}
+
+	for (auto& i: watches)
+	{
+		if (root_state.get_revision(i.slot) != i.revision)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename M>
+typename bmashina::BasicExecutor<M>::ActiveNodes::Type&
+bmashina::BasicExecutor<M>::get_active_nodes(const Tree& tree)
+{
+	if (active_tree != &tree)
+	{
+		auto iter = active_nodes.find(&tree);
+		if (iter == active_nodes.end())
+		{
+			iter = active_nodes.emplace(&tree, ActiveNodes::construct(mashina_instance)).first;
+		}
+
+		active_tree = &tree;
+		active_tree_nodes = &iter->second;
+	}
+
+	return *active_tree_nodes;
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::invalidate_active_nodes(const Tree& tree)
+{
+	auto iter = active_nodes.find(&tree);
+	if (iter != active_nodes.end())
+	{
+		iter->second.clear();
+	}
+}
+
 template <typename M>
 void bmashina::BasicExecutor<M>::push_frame(Tree& tree, Node* node)
 {
@@ -309,7 +567,8 @@ void bmashina::BasicExecutor<M>::push_frame(Tree& tree, Node* node)
 		current_frame = frame;
 	}
 
-	root_state.set_locals_key(current_frame->tree);
+	current_frame->watches = watches.size();
+	root_state.set_locals_scope(current_frame->scope);
 }
 
 template <typename M>
@@ -331,7 +590,7 @@ void bmashina::BasicExecutor<M>::leave_frame(Tree& tree, Node* node)
 		current_frame->index = 0;
 	}
 
-	root_state.set_locals_key(current_frame->tree);
+	root_state.set_locals_scope(current_frame->scope);
 }
 
 template <typename M>
@@ -360,28 +619,96 @@ std::size_t bmashina::BasicExecutor<M>::get_current_index() const
 	return current_frame->index;
 }
 
+template <typename M>
+typename bmashina::BasicExecutor<M>::TracerType&
+bmashina::BasicExecutor<M>::get_tracer()
+{
+	return tracer;
+}
+
+#ifndef BMASHINA_DISABLE_DEBUG
 template <typename M>
 void bmashina::BasicExecutor<M>::set_preview(Preview* value)
 {
-	preview = value;
+	tracer.set_preview(value);
+}
+#endif
+
+template <typename M>
+std::size_t bmashina::BasicExecutor<M>::get_frames_allocated() const
+{
+	return frames_allocated;
+}
+
+template <typename M>
+std::size_t bmashina::BasicExecutor<M>::get_frames_reused() const
+{
+	return frames_reused;
 }
 
 template <typename M>
 typename bmashina::BasicExecutor<M>::StateFrame*
 bmashina::BasicExecutor<M>::new_frame(Tree& tree, Node* node)
 {
-	return BasicAllocator::create<StateFrame>(allocator, *this, allocator, &tree, node, current_frame);
+	StateFrame* frame;
+	if (free_frames.empty())
+	{
+		++frames_allocated;
+		frame = BasicAllocator::create<StateFrame>(allocator, *this, &tree, node, current_frame);
+	}
+	else
+	{
+		++frames_reused;
+
+		frame = free_frames.back();
+		free_frames.pop_back();
+
+		frame->parent = current_frame;
+		frame->tree = &tree;
+		frame->node = node;
+		frame->index = 0;
+		frame->resume = 0;
+	}
+
+	if (node == nullptr)
+	{
+		frame->scope = root_state.get_locals_scope(&tree);
+	}
+	else
+	{
+		frame->scope = current_frame->scope;
+	}
+
+	return frame;
+}
+
+template <typename M>
+void bmashina::BasicExecutor<M>::release_frame(StateFrame* frame)
+{
+	if (frame->node == nullptr)
+	{
+		if (frame->tree != nullptr)
+		{
+			root_state.invalidate_locals_scope(frame->scope);
+			invalidate_active_nodes(*frame->tree);
+		}
+	}
+	else
+	{
+		frame->node->drop(*this);
+	}
+	frame->shrink(0);
+
+	free_frames.push_back(frame);
 }
 
 template <typename M>
 bmashina::BasicExecutor<M>::StateFrame::StateFrame(
 	Executor& executor,
-	AllocatorType& allocator,
 	Tree* tree,
 	Node* node,
 	StateFrame* parent) :
 	executor(&executor),
-	allocator(&allocator),
 	parent(parent),
 	tree(tree),
 	node(node),
@@ -390,30 +717,13 @@ bmashina::BasicExecutor<M>::StateFrame::StateFrame(
 	// Nothing.
 }
 
-template <typename M>
-bmashina::BasicExecutor<M>::StateFrame::~StateFrame()
-{
-	if (node == nullptr)
-	{
-		if (tree != nullptr)
-		{
-			executor->state().invalidate_locals(tree);
-		}
-	}
-	else
-	{
-		node->drop(*executor);
-	}
-	shrink(0);
-}
-
 template <typename M>
 void bmashina::BasicExecutor<M>::StateFrame::shrink(std::size_t size)
 {
 	while (children.size() > size)
 	{
 		auto back = children.back();
-		BasicAllocator::destroy<StateFrame>(*allocator, back);
+		executor->release_frame(back);
 
 		children.pop_back();
 	}
@@ -10,6 +10,7 @@
 #define BMASHINA_NODE_HPP
 
 #include <cassert>
+#include <cstddef>
 #include "bmashina/status.hpp"
 #include "bmashina/state/reference.hpp"
 
@@ -38,9 +39,11 @@ namespace bmashina
 		BasicNode(const BasicNode& other) = delete;
 		virtual ~BasicNode() = default;
 
-		void attach(Tree& tree);
+		void attach(Tree& tree, std::size_t ordinal);
 		bool attached() const;
 
+		std::size_t ordinal() const;
+
 		void visit(Executor& executor);
 		void drop(Executor& executor);
 		virtual Status update(Executor& executor);
@@ -58,12 +61,12 @@ namespace bmashina
 
 	private:
 		Tree* tree_instance = nullptr;
-		Local<bool> visited = Local<bool>("_node_visited");
+		std::size_t ordinal_value = 0;
 	};
 }
 
 template <typename M>
-void bmashina::BasicNode<M>::attach(Tree& tree)
+void bmashina::BasicNode<M>::attach(Tree& tree, std::size_t ordinal)
 {
 	assert(!attached());
 
@@ -75,6 +78,7 @@ void bmashina::BasicNode<M>::attach(Tree& tree)
 #endif
 
 	tree_instance = &tree;
+	ordinal_value = ordinal;
 }
 
 template <typename M>
@@ -83,6 +87,12 @@ bool bmashina::BasicNode<M>::attached() const
 	return tree_instance != nullptr;
 }
 
+template <typename M>
+std::size_t bmashina::BasicNode<M>::ordinal() const
+{
+	return ordinal_value;
+}
+
 template <typename M>
 typename bmashina::BasicNode<M>::Tree&
 bmashina::BasicNode<M>::tree()
@@ -118,9 +128,9 @@ bmashina::BasicNode<M>::tree() const
 template <typename M>
 void bmashina::BasicNode<M>::visit(Executor& executor)
 {
-	if (!executor.state().has(visited))
+	if (!executor.is_active(*this))
 	{
-		executor.state().set(visited, true);
+		executor.set_active(*this, true);
 
 		activated(executor);
 	}
@@ -129,10 +139,10 @@ void bmashina::BasicNode<M>::visit(Executor& executor)
 template <typename M>
 void bmashina::BasicNode<M>::drop(Executor& executor)
 {
-	if (executor.state().has(visited))
+	if (executor.is_active(*this))
 	{
 		deactivated(executor);
-		executor.state().unset(visited);
+		executor.set_active(*this, false);
 	}
 }
 
@@ -157,7 +167,7 @@ void bmashina::BasicNode<M>::deactivated(Executor& executor)
 template <typename M>
 void bmashina::BasicNode<M>::deactivate(Executor& executor)
 {
-	executor.state().unset(visited);
+	executor.set_active(*this, false);
 	deactivated(executor);
 }
 
@@ -0,0 +1,367 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_PARALLEL_EXECUTOR_HPP
+#define BMASHINA_PARALLEL_EXECUTOR_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "bmashina/config.hpp"
+#include "bmashina/executor.hpp"
+#include "bmashina/status.hpp"
+#include "bmashina/tree.hpp"
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+#include <exception>
+#include <stdexcept>
+#endif
+
+namespace bmashina
+{
+	// Ticks a population of executors against one tree on a pool of worker
+	// threads. Agents are split into chunks of 'grain' executors; each
+	// worker starts with a contiguous run of chunks and, once that is
+	// drained, steals chunks from the back of other workers' runs. The
+	// calling thread takes part as worker 0.
+	//
+	// Concurrency contract:
+	//
+	// - Each executor (and so each BasicState) must be ticked by at most one
+	//   thread at a time. An executor appears at most once per call.
+	// - The tree, and every tree reachable from it through child trees or
+	//   channel assignments, is shared read-only while execute() runs.
+	//   BasicTree::execute, update, children_begin/children_end, has and
+	//   assigned are safe to call concurrently. Everything that mutates a
+	//   tree (root, child, assign, unassign, local, constant, input, output,
+	//   clear and compile) must not overlap with a parallel tick.
+	// - execute() compiles the tree on the calling thread before any worker
+	//   starts. Child trees should be compiled up front.
+	// - Node::update, activated and deactivated must keep per-agent data in
+	//   the executor's state rather than in node members.
+	// - Creating and destroying references is thread-safe.
+	// - Nodes backed by a scripting runtime (such as lmashina's Lua nodes) are
+	//   not safe to run in parallel unless the runtime itself is.
+	template <typename M>
+	class BasicParallelExecutor
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicParallelExecutor<Mashina> ParallelExecutor;
+
+		// A 'num_threads' of zero uses one fewer worker thread than the
+		// hardware concurrency, since the calling thread also works.
+		BasicParallelExecutor(Mashina& mashina, std::size_t num_threads = 0);
+		BasicParallelExecutor(const ParallelExecutor& other) = delete;
+		~BasicParallelExecutor();
+
+		std::size_t get_num_threads() const;
+
+		// Ticks executors[0..count) against tree, storing each status in
+		// results. Blocks until every agent has been ticked. If a tick throws,
+		// the remaining agents still run and the first exception is rethrown.
+		void execute(
+			Tree& tree,
+			Executor* const* executors,
+			std::size_t count,
+			Status* results,
+			std::size_t grain = 32);
+
+		ParallelExecutor& operator =(const ParallelExecutor& other) = delete;
+
+	private:
+		Mashina mashina;
+
+		typedef typename Allocator<Mashina>::Type AllocatorType;
+		AllocatorType allocator;
+
+		struct Worker
+		{
+			std::mutex mutex;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+		};
+
+		typedef Vector<Mashina, Worker*> WorkerList;
+		typename WorkerList::Type workers;
+
+		typedef Vector<Mashina, std::thread> ThreadList;
+		typename ThreadList::Type threads;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		std::size_t generation = 0;
+		std::size_t pending = 0;
+		bool stopping = false;
+
+		Tree* job_tree = nullptr;
+		Executor* const* job_executors = nullptr;
+		Status* job_results = nullptr;
+		std::size_t job_count = 0;
+		std::size_t job_grain = 0;
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+		std::exception_ptr job_error;
+#endif
+
+		void work(std::size_t index);
+		void run(std::size_t index);
+		bool pop(std::size_t index, std::size_t& chunk);
+		bool steal(std::size_t index, std::size_t& chunk);
+		void tick(std::size_t chunk);
+	};
+}
+
+template <typename M>
+bmashina::BasicParallelExecutor<M>::BasicParallelExecutor(
+	Mashina& mashina,
+	std::size_t num_threads) :
+	mashina(mashina),
+	allocator(mashina),
+	workers(WorkerList::construct(mashina)),
+	threads(ThreadList::construct(mashina))
+{
+	if (num_threads == 0)
+	{
+		auto hardware_threads = std::thread::hardware_concurrency();
+		if (hardware_threads > 1)
+		{
+			num_threads = hardware_threads - 1;
+		}
+	}
+
+	for (std::size_t i = 0; i <= num_threads; ++i)
+	{
+		workers.push_back(BasicAllocator::create<Worker>(allocator));
+	}
+
+	for (std::size_t i = 1; i <= num_threads; ++i)
+	{
+		threads.emplace_back([this, i] { this->work(i); });
+	}
+}
+
+template <typename M>
+bmashina::BasicParallelExecutor<M>::~BasicParallelExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& thread: threads)
+	{
+		thread.join();
+	}
+
+	for (auto worker: workers)
+	{
+		BasicAllocator::destroy<Worker>(allocator, worker);
+	}
+}
+
+template <typename M>
+std::size_t bmashina::BasicParallelExecutor<M>::get_num_threads() const
+{
+	return threads.size();
+}
+
+template <typename M>
+void bmashina::BasicParallelExecutor<M>::execute(
+	Tree& tree,
+	Executor* const* executors,
+	std::size_t count,
+	Status* results,
+	std::size_t grain)
+{
+	assert(grain > 0);
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (grain == 0)
+	{
+		grain = 1;
+	}
+
+	if (!tree.compiled())
+	{
+		tree.compile();
+	}
+
+	auto num_chunks = (count + grain - 1) / grain;
+	auto num_workers = workers.size();
+	for (std::size_t i = 0; i < num_workers; ++i)
+	{
+		auto worker = workers[i];
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->begin = i * num_chunks / num_workers;
+		worker->end = (i + 1) * num_chunks / num_workers;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job_tree = &tree;
+		job_executors = executors;
+		job_results = results;
+		job_count = count;
+		job_grain = grain;
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+		job_error = nullptr;
+#endif
+
+		pending = threads.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	run(0);
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	std::exception_ptr error;
+#endif
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return pending == 0; });
+
+		job_tree = nullptr;
+		job_executors = nullptr;
+		job_results = nullptr;
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+		error = job_error;
+		job_error = nullptr;
+#endif
+	}
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+#endif
+}
+
+template <typename M>
+void bmashina::BasicParallelExecutor<M>::work(std::size_t index)
+{
+	std::size_t current_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, current_generation]
+			{
+				return stopping || generation != current_generation;
+			});
+
+			if (stopping)
+			{
+				return;
+			}
+
+			current_generation = generation;
+		}
+
+		run(index);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--pending;
+			if (pending == 0)
+			{
+				done.notify_all();
+			}
+		}
+	}
+}
+
+template <typename M>
+void bmashina::BasicParallelExecutor<M>::run(std::size_t index)
+{
+	std::size_t chunk;
+	while (pop(index, chunk) || steal(index, chunk))
+	{
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+		try
+		{
+			tick(chunk);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!job_error)
+			{
+				job_error = std::current_exception();
+			}
+		}
+#else
+		tick(chunk);
+#endif
+	}
+}
+
+template <typename M>
+bool bmashina::BasicParallelExecutor<M>::pop(std::size_t index, std::size_t& chunk)
+{
+	auto worker = workers[index];
+	std::lock_guard<std::mutex> lock(worker->mutex);
+
+	if (worker->begin < worker->end)
+	{
+		chunk = worker->begin;
+		++worker->begin;
+		return true;
+	}
+
+	return false;
+}
+
+template <typename M>
+bool bmashina::BasicParallelExecutor<M>::steal(std::size_t index, std::size_t& chunk)
+{
+	auto num_workers = workers.size();
+	for (std::size_t i = 1; i < num_workers; ++i)
+	{
+		auto victim = workers[(index + i) % num_workers];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+
+		if (victim->begin < victim->end)
+		{
+			--victim->end;
+			chunk = victim->end;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename M>
+void bmashina::BasicParallelExecutor<M>::tick(std::size_t chunk)
+{
+	auto begin = chunk * job_grain;
+	auto end = begin + job_grain;
+	if (end > job_count)
+	{
+		end = job_count;
+	}
+
+	for (auto i = begin; i < end; ++i)
+	{
+		job_results[i] = job_tree->execute(*job_executors[i]);
+	}
+}
+
+#endif
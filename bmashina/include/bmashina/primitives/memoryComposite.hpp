@@ -0,0 +1,71 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_PRIMITIVES_MEMORY_COMPOSITE_HPP
+#define BMASHINA_PRIMITIVES_MEMORY_COMPOSITE_HPP
+
+#include <cstddef>
+#include "bmashina/composite.hpp"
+
+namespace bmashina
+{
+	// Updates children in order while they return 'Continue', resuming a
+	// child that returned working on the next update instead of
+	// re-evaluating its earlier siblings. The first other status is returned;
+	// if every child returns 'Continue', so does the composite.
+	template <typename M, Status Continue>
+	class BasicMemoryComposite : public BasicComposite<M>
+	{
+	public:
+		using typename BasicNode<M>::Tree;
+		using typename BasicNode<M>::Executor;
+
+		BasicMemoryComposite() = default;
+		~BasicMemoryComposite() = default;
+
+		Status update(Executor& executor) override;
+	};
+}
+
+template <typename M, bmashina::Status Continue>
+bmashina::Status bmashina::BasicMemoryComposite<M, Continue>::update(Executor& executor)
+{
+	auto current = this->tree().children_begin(*this);
+	auto end = this->tree().children_end(*this);
+
+	std::size_t index = 0;
+	std::size_t resume = executor.resume();
+	while (index < resume && current != end)
+	{
+		++current;
+		++index;
+	}
+
+	while (current != end)
+	{
+		auto result = executor.update(*current);
+		if (result == bmashina::Status::working)
+		{
+			executor.suspend(index);
+			return bmashina::Status::working;
+		}
+		else if (result != Continue)
+		{
+			executor.suspend(0);
+			return result;
+		}
+
+		++current;
+		++index;
+	}
+
+	executor.suspend(0);
+	return Continue;
+}
+
+#endif
@@ -0,0 +1,27 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_PRIMITIVES_MEMORY_SELECTOR_HPP
+#define BMASHINA_PRIMITIVES_MEMORY_SELECTOR_HPP
+
+#include "bmashina/primitives/memoryComposite.hpp"
+
+namespace bmashina
+{
+	// Like Selector, but a child that returned working is resumed on the next
+	// update instead of re-evaluating its earlier siblings.
+	template <typename M>
+	class MemorySelector : public BasicMemoryComposite<M, Status::failure>
+	{
+	public:
+		MemorySelector() = default;
+		~MemorySelector() = default;
+	};
+}
+
+#endif
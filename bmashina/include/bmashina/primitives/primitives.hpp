@@ -11,6 +11,8 @@
 
 #include "bmashina/primitives/failure.hpp"
 #include "bmashina/primitives/invert.hpp"
+#include "bmashina/primitives/memorySelector.hpp"
+#include "bmashina/primitives/memorySequence.hpp"
 #include "bmashina/primitives/sequence.hpp"
 #include "bmashina/primitives/selector.hpp"
 #include "bmashina/primitives/success.hpp"
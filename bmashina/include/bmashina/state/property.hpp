@@ -10,6 +10,7 @@
 #define BMASHINA_STATE_PROPERTY_HPP
 
 #include <string>
+#include <type_traits>
 #include "bmashina/config.hpp"
 
 namespace bmashina
@@ -23,6 +24,28 @@ namespace bmashina
 
 			virtual BaseProperty* clone(BasicAllocator& allocator) const = 0;
 		};
+
+		// The address of TAG identifies the value type of a property.
+		template <typename V>
+		struct PropertyType
+		{
+			static const char TAG;
+		};
+
+		// Small, trivially copyable values are stored inline by BasicState
+		// instead of behind a heap-allocated Property.
+		constexpr std::size_t INLINE_PROPERTY_SIZE = 16;
+
+		template <typename V>
+		struct is_inline_property : std::integral_constant<
+			bool,
+			std::is_trivially_copyable<V>::value &&
+			!std::is_pointer<V>::value &&
+			sizeof(V) <= INLINE_PROPERTY_SIZE &&
+			alignof(V) <= alignof(std::max_align_t)>
+		{
+			// Nothing.
+		};
 	}
 
 	template <typename V>
@@ -86,6 +109,9 @@ namespace bmashina
 #endif
 }
 
+template <typename V>
+const char bmashina::detail::PropertyType<V>::TAG = 0;
+
 template <typename V>
 bmashina::Property<V>::Property(const Value& value) : value(value)
 {
@@ -10,17 +10,53 @@
 #define BMASHINA_STATE_REFERENCE_HPP
 
 #include <cstddef>
+#include <cstdlib>
+#include <mutex>
 
 namespace bmashina
 {
 	namespace detail
 	{
+		// Hands out dense integer slots. Slots are recycled when the owning
+		// reference is destroyed, so the highest slot in use stays close to
+		// the number of live references.
+		class SlotRegistry
+		{
+		public:
+			static std::size_t acquire();
+			static void release(std::size_t slot);
+
+		private:
+			SlotRegistry() = default;
+			~SlotRegistry();
+
+			static SlotRegistry& instance();
+
+			std::mutex mutex;
+			std::size_t next_slot = 0;
+
+			std::size_t* free_slots = nullptr;
+			std::size_t num_free_slots = 0;
+			std::size_t max_free_slots = 0;
+		};
+
 		struct BaseReference
 		{
-			BaseReference() = default;
-			BaseReference(const char* name);
+			BaseReference();
+			BaseReference(const char* name, bool local = false);
+			BaseReference(const BaseReference& other);
+			~BaseReference();
+
+			BaseReference& operator =(const BaseReference& other);
 
 			const char* name = nullptr;
+
+			// True for Local references.
+			const bool local = false;
+
+			// Index of the reference in a BasicState. Unique among live
+			// references.
+			const std::size_t slot;
 		};
 	}
 
@@ -41,12 +77,94 @@ namespace bmashina
 	};
 }
 
-inline bmashina::detail::BaseReference::BaseReference(const char* name) :
-	name(name)
+inline bmashina::detail::SlotRegistry::~SlotRegistry()
+{
+	std::free(free_slots);
+}
+
+inline bmashina::detail::SlotRegistry&
+bmashina::detail::SlotRegistry::instance()
+{
+	static SlotRegistry registry;
+	return registry;
+}
+
+inline std::size_t bmashina::detail::SlotRegistry::acquire()
+{
+	auto& registry = instance();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	if (registry.num_free_slots > 0)
+	{
+		--registry.num_free_slots;
+		return registry.free_slots[registry.num_free_slots];
+	}
+
+	return registry.next_slot++;
+}
+
+inline void bmashina::detail::SlotRegistry::release(std::size_t slot)
+{
+	auto& registry = instance();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	if (registry.num_free_slots == registry.max_free_slots)
+	{
+		auto max_free_slots = registry.max_free_slots * 2;
+		if (max_free_slots == 0)
+		{
+			max_free_slots = 64;
+		}
+
+		auto free_slots = std::realloc(registry.free_slots, max_free_slots * sizeof(std::size_t));
+		if (free_slots == nullptr)
+		{
+			// Leaking the slot is harmless.
+			return;
+		}
+
+		registry.free_slots = static_cast<std::size_t*>(free_slots);
+		registry.max_free_slots = max_free_slots;
+	}
+
+	registry.free_slots[registry.num_free_slots] = slot;
+	++registry.num_free_slots;
+}
+
+inline bmashina::detail::BaseReference::BaseReference() :
+	slot(SlotRegistry::acquire())
+{
+	// Nothing.
+}
+
+inline bmashina::detail::BaseReference::BaseReference(const char* name, bool local) :
+	name(name),
+	local(local),
+	slot(SlotRegistry::acquire())
+{
+	// Nothing.
+}
+
+inline bmashina::detail::BaseReference::BaseReference(const BaseReference& other) :
+	name(other.name),
+	local(other.local),
+	slot(SlotRegistry::acquire())
 {
 	// Nothing.
 }
 
+inline bmashina::detail::BaseReference::~BaseReference()
+{
+	SlotRegistry::release(slot);
+}
+
+inline bmashina::detail::BaseReference&
+bmashina::detail::BaseReference::operator =(const BaseReference& other)
+{
+	name = other.name;
+	return *this;
+}
+
 template <typename V>
 bmashina::Reference<V>::Reference(const char* name) :
 	detail::BaseReference(name)
@@ -56,7 +174,7 @@ bmashina::Reference<V>::Reference(const char* name) :
 
 template <typename V>
 bmashina::Local<V>::Local(const char* name) :
-	detail::BaseReference(name)
+	detail::BaseReference(name, true)
 {
 	// Nothing.
 }
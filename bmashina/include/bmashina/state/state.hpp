@@ -9,6 +9,9 @@
 #ifndef BMASHINA_STATE_STATE_HPP
 #define BMASHINA_STATE_STATE_HPP
 
+#include <cstddef>
+#include <new>
+#include <type_traits>
 #include "bmashina/config.hpp"
 #include "bmashina/state/property.hpp"
 #include "bmashina/state/reference.hpp"
@@ -52,13 +55,42 @@ namespace bmashina
 		template <typename R>
 		void set(const R& reference, const Property<typename R::Type>& value);
 
+		// Typed access through an untyped reference, for bindings that keep
+		// values of several types under one reference. get_as returns null
+		// unless the reference currently holds a V.
+		template <typename V>
+		bool holds(const detail::BaseReference& reference) const;
+
+		template <typename V>
+		const V* get_as(const detail::BaseReference& reference) const;
+
+		template <typename V>
+		void set_as(const detail::BaseReference& reference, const Property<V>& value);
+
 		void reserve(const detail::BaseReference& reference);
 
 		void unset(const detail::BaseReference& reference);
 		void clear();
 
+		// Revisions grow every time a value is set, copied over or removed.
+		// The revision of a reference is that of the last change to its slot.
+		std::size_t get_revision() const;
+		std::size_t get_revision(const detail::BaseReference& reference) const;
+		std::size_t get_revision(std::size_t slot) const;
+
 		State& operator =(const State& other) = delete;
 
+		// Locals belong to the scope that was current when they were set.
+		// Entering a scope and invalidating all of its locals are constant
+		// time: invalidation bumps the scope's generation and values from an
+		// older generation are treated as unset and dropped lazily.
+		//
+		// get_locals_scope maps a key (e.g., a tree) to its scope, creating it
+		// if needed; the result is stable and meant to be cached.
+		std::size_t get_locals_scope(const void* key);
+		void set_locals_scope(std::size_t scope);
+		void invalidate_locals_scope(std::size_t scope);
+
 		void set_locals_key(const void* key);
 		void invalidate_locals(const void* key);
 
@@ -71,6 +103,30 @@ namespace bmashina
 			const detail::BaseReference& source_reference,
 			const detail::BaseReference& destination_reference);
 
+		// Same as copy, but a value that needs a heap-allocated property is
+		// allocated from the destination's scratch allocator, if it has one.
+		// For values that only live for the current tick, like wired inputs.
+		static void copy_scratch(
+			const State& source, State& destination,
+			const detail::BaseReference& source_reference,
+			const detail::BaseReference& destination_reference);
+
+		void set_scratch_allocator(BasicAllocator* value);
+
+		// Values not present in this state are read from fallback, and from
+		// its fallback in turn. The fallback is never modified through this
+		// state. Used to serve tree constants without copying them.
+		void set_fallback(const State* value);
+		const State* get_fallback() const;
+
+		// Same as copying source_reference to destination_reference and then
+		// unsetting source_reference, but hands over the value instead. Values
+		// in the scratch allocator are still copied.
+		static void move(
+			State& state,
+			const detail::BaseReference& source_reference,
+			const detail::BaseReference& destination_reference);
+
 #ifndef BMASHINA_DISABLE_DEBUG
 		typedef typename String<M>::Type StringType;
 		typedef std::function<void(const StringType& key, const StringType& value)> PropertyIter;
@@ -82,21 +138,99 @@ namespace bmashina
 
 		typedef typename Allocator<Mashina>::Type AllocatorType;
 		AllocatorType allocator;
+		BasicAllocator* scratch_allocator = nullptr;
+		const State* fallback = nullptr;
+
+		struct Scope
+		{
+			std::size_t generation;
+
+			// Revision at which the scope was last invalidated.
+			std::size_t revision;
+		};
+		typedef Vector<Mashina, Scope> ScopeList;
+		typename ScopeList::Type scopes;
+
+		typedef UnorderedMap<Mashina, const void*, std::size_t> ScopeMap;
+		typename ScopeMap::Type scopes_by_key;
+		std::size_t current_scope = 0;
+
+		// Values are indexed by reference slot. A value is held either
+		// inline, for small trivially copyable types, or behind a
+		// heap-allocated Property. Slots are grouped into pages so a state
+		// only pays for the slot ranges it actually touches.
+		struct Value;
+
+		typedef void (* AssignFunc)(const Value& source, Value& destination);
+
+		template <typename V>
+		static void assign(const Value& source, Value& destination);
 
 #ifndef BMASHINA_DISABLE_DEBUG
-		typedef std::function<StringType(Mashina&, const State&, const detail::BaseReference*)> PropertyPrintFunc;
-		typedef UnorderedMap<Mashina, const detail::BaseReference*, PropertyPrintFunc> ValuePrinterMap;
-		typename ValuePrinterMap::Type value_printers;
+		typedef StringType (* PrintFunc)(Mashina& mashina, const Value& value);
+
+		template <typename V>
+		static StringType print(Mashina& mashina, const Value& value);
 #endif
 
-		const void* current_locals_key = nullptr;
-		typedef UnorderedSet<Mashina, const detail::BaseReference*> LocalSet;
-		typedef UnorderedMap<Mashina, const void*, typename LocalSet::Type> LocalMap;
-		typename LocalMap::Type locals_by_key;
-		typename LocalSet::Type locals;
+		struct Value
+		{
+			const detail::BaseReference* reference = nullptr;
+			const void* type = nullptr;
+			detail::BaseProperty* property = nullptr;
+			bool is_local = false;
+			bool is_scratch = false;
+			std::size_t scope = 0;
+			std::size_t generation = 0;
+			std::size_t revision = 0;
+			AssignFunc assign = nullptr;
+#ifndef BMASHINA_DISABLE_DEBUG
+			PrintFunc print = nullptr;
+#endif
+			typename std::aligned_storage<
+				detail::INLINE_PROPERTY_SIZE,
+				alignof(std::max_align_t)>::type storage;
+		};
 
-		typedef UnorderedMap<Mashina, const detail::BaseReference*, detail::BaseProperty*> ValueMap;
-		typename ValueMap::Type values;
+		static const std::size_t PAGE_SIZE = 32;
+		struct Page
+		{
+			Value values[PAGE_SIZE];
+		};
+
+		typedef Vector<Mashina, Page*> PageList;
+		typename PageList::Type pages;
+		std::size_t revision = 0;
+
+		const Value* find_value(const detail::BaseReference& reference) const;
+		const Value* find_local_value(const detail::BaseReference& reference) const;
+		Value& get_value(const detail::BaseReference& reference);
+		void release_value(Value& value);
+		void reset_value(Value& value);
+		void mark_local(Value& value);
+		bool is_stale(const Value& value) const;
+		static void copy_value(
+			const Value& source,
+			State& destination,
+			Value& value,
+			bool scratch = false);
+		static void copy_reference(
+			const State& source, State& destination,
+			const detail::BaseReference& source_reference,
+			const detail::BaseReference& destination_reference,
+			bool scratch);
+
+		template <typename V>
+		static V load(const Value& value);
+
+		template <typename V>
+		void store(Value& value, const Property<V>& property);
+
+		template <typename V>
+		void store(Value& value, const Property<V>& property, std::true_type);
+
+		template <typename V>
+		void store(Value& value, const Property<V>& property, std::false_type);
 
 		template <typename V>
 		void set_value(const Reference<V>& reference, const Property<V>& value);
@@ -112,9 +246,9 @@ template <typename M>
 bmashina::BasicState<M>::BasicState(Mashina& mashina) :
 	mashina(mashina),
 	allocator(mashina),
-	locals_by_key(LocalMap::construct(mashina)),
-	locals(LocalSet::construct(mashina)),
-	values(ValueMap::construct(mashina))
+	scopes(ScopeList::construct(mashina)),
+	scopes_by_key(ScopeMap::construct(mashina)),
+	pages(PageList::construct(mashina))
 {
 	set_locals_key(nullptr);
 }
@@ -123,13 +257,21 @@ template <typename M>
 bmashina::BasicState<M>::~BasicState()
 {
 	clear();
+
+	for (auto page: pages)
+	{
+		if (page != nullptr)
+		{
+			BasicAllocator::destroy<Page>(allocator, page);
+		}
+	}
 }
 
 template <typename M>
 bool bmashina::BasicState<M>::has(const detail::BaseReference& reference) const
 {
-	auto iter = values.find(&reference);
-	if (iter == values.end() || iter->second == nullptr)
+	auto value = find_value(reference);
+	if (value == nullptr || value->type == nullptr)
 	{
 		return false;
 	}
@@ -142,24 +284,24 @@ template <typename R>
 typename R::Type
 bmashina::BasicState<M>::get(const R& reference) const
 {
-	auto iter = values.find(&reference);
+	auto value = find_value(reference);
 
-	assert(iter != values.end());
-	assert(iter->second != nullptr);
+	assert(value != nullptr);
+	assert(value->type != nullptr);
 
 #ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
-	if (iter == values.end())
+	if (value == nullptr)
 	{
 		throw std::runtime_error("property not in state");
 	}
 
-	if (iter->second == nullptr)
+	if (value->type == nullptr)
 	{
 		throw std::runtime_error("property no longer in state");
 	}
 #endif
 
-	return (static_cast<Property<typename R::Type>*>(iter->second))->get();
+	return load<typename R::Type>(*value);
 }
 
 template <typename M>
@@ -167,23 +309,23 @@ template <typename R>
 typename R::Type
 bmashina::BasicState<M>::get(const R& reference, const typename R::Type& default_value) const
 {
-	auto value = values.find(&reference);
-	if (value == values.end() || value->second == nullptr)
+	auto value = find_value(reference);
+	if (value == nullptr || value->type == nullptr)
 	{
 		return default_value;
 	}
 	else
 	{
-		return (static_cast<Property<typename R::Type>*>(value->second))->get();
+		return load<typename R::Type>(*value);
 	}
 }
 
 template <typename M>
 void bmashina::BasicState<M>::reserve(const detail::BaseReference& reference)
 {
-	if (values.count(&reference) == 0)
+	if (find_local_value(reference) == nullptr)
 	{
-		values[&reference] = nullptr;
+		get_value(reference);
 	}
 }
 
@@ -202,96 +344,150 @@ void bmashina::BasicState<M>::set(const R& reference, const Property<typename R:
 
 template <typename M>
 template <typename V>
-void bmashina::BasicState<M>::set_value(const Reference<V>& reference, const Property<V>& value)
+bool bmashina::BasicState<M>::holds(const detail::BaseReference& reference) const
 {
-	remove_value(&reference);
-
-	auto property = BasicAllocator::create<Property<V>>(allocator, value);
-	values[&reference] = property;
+	auto value = find_value(reference);
+	return value != nullptr && value->type == &detail::PropertyType<V>::TAG;
+}
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	auto printer = [](Mashina& mashina, const State& state, const detail::BaseReference* reference)
+template <typename M>
+template <typename V>
+const V* bmashina::BasicState<M>::get_as(const detail::BaseReference& reference) const
+{
+	auto value = find_value(reference);
+	if (value == nullptr || value->type != &detail::PropertyType<V>::TAG)
 	{
-		auto value = state.values.find(reference);
-		assert(value != state.values.end());
+		return nullptr;
+	}
 
-		auto property = static_cast<Property<V>*>(value->second);
-		return PropertyPrinter<Mashina, V>::print(mashina, *property);
-	};
+	if (value->property == nullptr)
+	{
+		return std::launder(reinterpret_cast<const V*>(&value->storage));
+	}
 
-	value_printers[&reference] = printer;
-#endif
+	return &static_cast<const Property<V>*>(value->property)->get();
 }
 
 template <typename M>
 template <typename V>
-void bmashina::BasicState<M>::set_value(const Local<V>& local, const Property<V>& value)
+void bmashina::BasicState<M>::set_as(const detail::BaseReference& reference, const Property<V>& value)
 {
-	remove_value(&local);
-
-	auto property = BasicAllocator::create<Property<V>>(allocator, value);
-	values[&local] = property;
-	locals_by_key[current_locals_key].insert(&local);
-	locals.insert(&local);
+	auto& v = get_value(reference);
+	store<V>(v, value);
 
-#ifndef BMASHINA_DISABLE_DEBUG
-	auto printer = [](Mashina& mashina, const State& state, const detail::BaseReference* local)
+	if (reference.local)
 	{
-		auto value = state.values.find(local);
-		assert(value != state.values.end());
+		mark_local(v);
+	}
+}
 
-		auto property = static_cast<Property<V>*>(value->second);
-		return PropertyPrinter<Mashina, V>::print(mashina, *property);
-	};
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::set_value(const Reference<V>& reference, const Property<V>& value)
+{
+	store<V>(get_value(reference), value);
+}
 
-	value_printers[&local] = printer;
-#endif
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::set_value(const Local<V>& local, const Property<V>& value)
+{
+	auto& v = get_value(local);
+	store<V>(v, value);
+	mark_local(v);
 }
 
 template <typename M>
 void bmashina::BasicState<M>::clear()
 {
-	for (auto& value: values)
+	for (auto page: pages)
 	{
-		if (value.second != nullptr)
+		if (page != nullptr)
 		{
-			BasicAllocator::destroy<detail::BaseProperty>(allocator, value.second);
+			for (auto& value: page->values)
+			{
+				reset_value(value);
+			}
 		}
 	}
-	values.clear();
-	locals_by_key.clear();
-	locals.clear();
-#ifndef BMASHINA_DISABLE_DEBUG
-	value_printers.clear();
-#endif
 }
 
 template <typename M>
-void bmashina::BasicState<M>::set_locals_key(const void* key)
+std::size_t bmashina::BasicState<M>::get_revision() const
+{
+	return revision;
+}
+
+template <typename M>
+std::size_t bmashina::BasicState<M>::get_revision(const detail::BaseReference& reference) const
 {
-	current_locals_key = key;
-	if (locals_by_key.count(key) == 0)
+	return get_revision(reference.slot);
+}
+
+template <typename M>
+std::size_t bmashina::BasicState<M>::get_revision(std::size_t slot) const
+{
+	auto page = slot / PAGE_SIZE;
+	if (page >= pages.size() || pages[page] == nullptr)
 	{
-		locals_by_key.emplace(key, LocalSet::construct(mashina));
+		return 0;
 	}
+
+	auto& value = pages[page]->values[slot % PAGE_SIZE];
+	if (is_stale(value))
+	{
+		return scopes[value.scope].revision;
+	}
+
+	return value.revision;
 }
 
 template <typename M>
-void bmashina::BasicState<M>::invalidate_locals(const void* key)
+std::size_t bmashina::BasicState<M>::get_locals_scope(const void* key)
 {
-	auto iter = locals_by_key.find(key);
-	if (iter != locals_by_key.end())
+	auto iter = scopes_by_key.find(key);
+	if (iter != scopes_by_key.end())
 	{
-		for (auto i: iter->second)
-		{
-			locals.erase(i);
-			values.erase(i);
-#ifndef BMASHINA_DISABLE_DEBUG
-			value_printers.erase(i);
-#endif
-		}
+		return iter->second;
+	}
+
+	auto scope = scopes.size();
+	scopes.push_back({ 0, 0 });
+	scopes_by_key.emplace(key, scope);
+
+	return scope;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::set_locals_scope(std::size_t scope)
+{
+	assert(scope < scopes.size());
+	current_scope = scope;
+}
 
-		locals_by_key.erase(iter);
+template <typename M>
+void bmashina::BasicState<M>::invalidate_locals_scope(std::size_t scope)
+{
+	assert(scope < scopes.size());
+
+	auto& s = scopes[scope];
+	++s.generation;
+	s.revision = ++revision;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::set_locals_key(const void* key)
+{
+	set_locals_scope(get_locals_scope(key));
+}
+
+template <typename M>
+void bmashina::BasicState<M>::invalidate_locals(const void* key)
+{
+	auto iter = scopes_by_key.find(key);
+	if (iter != scopes_by_key.end())
+	{
+		invalidate_locals_scope(iter->second);
 	}
 }
 
@@ -300,9 +496,18 @@ void bmashina::BasicState<M>::copy(
 	const State& source,
 	State& destination)
 {
-	for (auto i: source.values)
+	for (auto page: source.pages)
 	{
-		copy(source, destination, *i.first);
+		if (page != nullptr)
+		{
+			for (auto& value: page->values)
+			{
+				if (value.reference != nullptr)
+				{
+					copy(source, destination, *value.reference);
+				}
+			}
+		}
 	}
 }
 
@@ -317,125 +522,444 @@ void bmashina::BasicState<M>::copy(
 		return;
 	}
 
-	if (source.values.count(&reference) != 0)
+	auto value = source.find_value(reference);
+	if (value != nullptr)
 	{
-		auto value = source.values.find(&reference);
-		assert(value != source.values.end());
-
-		destination.remove_value(&reference);
-		if (value->second != nullptr)
+		if (value->type == nullptr)
 		{
-			destination.values[&reference] = value->second->clone(destination.allocator);
-			if (source.locals.count(&reference) != 0)
+			destination.remove_value(&reference);
+		}
+		else
+		{
+			auto& v = destination.get_value(reference);
+			copy_value(*value, destination, v);
+
+			if (value->is_local)
 			{
-				destination.locals.insert(&reference);
-				destination.locals_by_key[destination.current_locals_key].insert(&reference);
+				destination.mark_local(v);
 			}
 		}
+	}
+}
 
-#ifndef BMASHINA_DISABLE_DEBUG
-		auto printer = source.value_printers.find(&reference);
-		if (printer == source.value_printers.end())
+template <typename M>
+void bmashina::BasicState<M>::copy(
+	const State& source,
+	State& destination,
+	const detail::BaseReference& source_reference,
+	const detail::BaseReference& destination_reference)
+{
+	copy_reference(source, destination, source_reference, destination_reference, false);
+}
+
+template <typename M>
+void bmashina::BasicState<M>::copy_scratch(
+	const State& source,
+	State& destination,
+	const detail::BaseReference& source_reference,
+	const detail::BaseReference& destination_reference)
+{
+	copy_reference(source, destination, source_reference, destination_reference, true);
+}
+
+template <typename M>
+void bmashina::BasicState<M>::copy_reference(
+	const State& source,
+	State& destination,
+	const detail::BaseReference& source_reference,
+	const detail::BaseReference& destination_reference,
+	bool scratch)
+{
+	if (&source == &destination && &source_reference == &destination_reference)
+	{
+		return;
+	}
+
+	auto value = source.find_value(source_reference);
+	if (value != nullptr)
+	{
+		if (value->type == nullptr)
 		{
-			destination.value_printers.erase(&reference);
+			destination.remove_value(&destination_reference);
 		}
 		else
 		{
-			destination.value_printers[&reference] = printer->second;
+			copy_value(*value, destination, destination.get_value(destination_reference), scratch);
 		}
-#endif
 	}
 }
 
 template <typename M>
-void bmashina::BasicState<M>::copy(
-	const State& source,
-	State& destination,
+void bmashina::BasicState<M>::set_scratch_allocator(BasicAllocator* value)
+{
+	scratch_allocator = value;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::set_fallback(const State* value)
+{
+	assert(value != this);
+	fallback = value;
+}
+
+template <typename M>
+const typename bmashina::BasicState<M>::State*
+bmashina::BasicState<M>::get_fallback() const
+{
+	return fallback;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::move(
+	State& state,
 	const detail::BaseReference& source_reference,
 	const detail::BaseReference& destination_reference)
 {
-	if (&source == &destination && &source_reference == &destination_reference)
+	if (&source_reference == &destination_reference)
 	{
+		state.remove_value(&source_reference);
 		return;
 	}
 
-	if (source.values.count(&source_reference) != 0)
+	auto source = state.find_local_value(source_reference);
+	if (source == nullptr)
 	{
-		auto source_value = source.values.find(&source_reference);
+		// Values in the fallback can't be handed over.
+		copy(state, state, source_reference, destination_reference);
+		return;
+	}
 
-		assert(source_value != source.values.end());
+	if (source->type == nullptr)
+	{
+		state.remove_value(&destination_reference);
+	}
+	else
+	{
+		auto& value = state.get_value(destination_reference);
+		auto& s = const_cast<Value&>(*source);
 
-		destination.remove_value(&destination_reference);
-		if (source_value->second != nullptr)
+		if (s.is_scratch)
 		{
-			destination.values[&destination_reference] = source_value->second->clone(destination.allocator);
+			// Scratch values must not outlive the tick, or the scratch
+			// allocator never empties; copy them out of it instead.
+			copy_value(s, state, value, false);
 		}
-
+		else
+		{
+			state.release_value(value);
+			value.storage = s.storage;
+			value.property = s.property;
+			value.type = s.type;
+			value.assign = s.assign;
 #ifndef BMASHINA_DISABLE_DEBUG
-		auto printer = source.value_printers.find(&source_reference);
-		if (printer == source.value_printers.end())
+			value.print = s.print;
+#endif
+
+			s.property = nullptr;
+		}
+	}
+
+	state.remove_value(&source_reference);
+}
+
+template <typename M>
+const typename bmashina::BasicState<M>::Value*
+bmashina::BasicState<M>::find_value(const detail::BaseReference& reference) const
+{
+	auto value = find_local_value(reference);
+	if ((value == nullptr || value->type == nullptr) && fallback != nullptr)
+	{
+		auto fallback_value = fallback->find_value(reference);
+		if (fallback_value != nullptr)
+		{
+			return fallback_value;
+		}
+	}
+
+	return value;
+}
+
+template <typename M>
+const typename bmashina::BasicState<M>::Value*
+bmashina::BasicState<M>::find_local_value(const detail::BaseReference& reference) const
+{
+	auto page = reference.slot / PAGE_SIZE;
+	if (page >= pages.size() || pages[page] == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& value = pages[page]->values[reference.slot % PAGE_SIZE];
+	if (value.reference != &reference || is_stale(value))
+	{
+		return nullptr;
+	}
+
+	return &value;
+}
+
+template <typename M>
+typename bmashina::BasicState<M>::Value&
+bmashina::BasicState<M>::get_value(const detail::BaseReference& reference)
+{
+	auto page = reference.slot / PAGE_SIZE;
+	if (page >= pages.size())
+	{
+		pages.resize(page + 1, nullptr);
+	}
+
+	if (pages[page] == nullptr)
+	{
+		pages[page] = BasicAllocator::create<Page>(allocator);
+	}
+
+	auto& value = pages[page]->values[reference.slot % PAGE_SIZE];
+	if (value.reference != &reference || is_stale(value))
+	{
+		// The slot belonged to a reference that has since been destroyed, or
+		// to a local whose scope has been invalidated.
+		reset_value(value);
+		value.reference = &reference;
+	}
+	value.revision = ++revision;
+
+	return value;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::release_value(Value& value)
+{
+	if (value.property != nullptr)
+	{
+		if (value.is_scratch)
 		{
-			destination.value_printers.erase(&destination_reference);
+			assert(scratch_allocator != nullptr);
+			BasicAllocator::destroy<detail::BaseProperty>(*scratch_allocator, value.property);
 		}
 		else
 		{
-			destination.value_printers[&destination_reference] = printer->second;
+			BasicAllocator::destroy<detail::BaseProperty>(allocator, value.property);
 		}
+		value.property = nullptr;
+	}
+	value.is_scratch = false;
+
+	value.type = nullptr;
+	value.assign = nullptr;
+#ifndef BMASHINA_DISABLE_DEBUG
+	value.print = nullptr;
+#endif
+}
+
+template <typename M>
+void bmashina::BasicState<M>::reset_value(Value& value)
+{
+	if (value.reference != nullptr)
+	{
+		value.revision = ++revision;
+	}
+
+	release_value(value);
+	value.reference = nullptr;
+	value.is_local = false;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::mark_local(Value& value)
+{
+	value.is_local = true;
+	value.scope = current_scope;
+	value.generation = scopes[current_scope].generation;
+}
+
+template <typename M>
+bool bmashina::BasicState<M>::is_stale(const Value& value) const
+{
+	return value.is_local && value.generation != scopes[value.scope].generation;
+}
+
+template <typename M>
+void bmashina::BasicState<M>::copy_value(
+	const Value& source,
+	State& destination,
+	Value& value,
+	bool scratch)
+{
+	if (&source == &value)
+	{
+		return;
+	}
+
+	if (source.property != nullptr && value.property != nullptr && source.type == value.type)
+	{
+		source.assign(source, value);
+		return;
+	}
+
+	destination.release_value(value);
+	if (source.property == nullptr)
+	{
+		value.storage = source.storage;
+	}
+	else if (scratch && destination.scratch_allocator != nullptr)
+	{
+		value.property = source.property->clone(*destination.scratch_allocator);
+		value.is_scratch = true;
+	}
+	else
+	{
+		value.property = source.property->clone(destination.allocator);
+	}
+
+	value.type = source.type;
+	value.assign = source.assign;
+#ifndef BMASHINA_DISABLE_DEBUG
+	value.print = source.print;
+#endif
+}
+
+template <typename M>
+template <typename V>
+V bmashina::BasicState<M>::load(const Value& value)
+{
+	if (value.property == nullptr)
+	{
+		return *std::launder(reinterpret_cast<const V*>(&value.storage));
+	}
+
+	return static_cast<const Property<V>*>(value.property)->get();
+}
+
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::store(Value& value, const Property<V>& property)
+{
+	store<V>(value, property, detail::is_inline_property<V>());
+}
+
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::store(Value& value, const Property<V>& property, std::true_type)
+{
+	if (value.type != &detail::PropertyType<V>::TAG)
+	{
+		release_value(value);
+		value.type = &detail::PropertyType<V>::TAG;
+#ifndef BMASHINA_DISABLE_DEBUG
+		value.print = &print<V>;
+#endif
+	}
+
+	new(&value.storage) V(property.get());
+}
+
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::store(Value& value, const Property<V>& property, std::false_type)
+{
+	if (value.type == &detail::PropertyType<V>::TAG && value.property != nullptr)
+	{
+		*static_cast<Property<V>*>(value.property) = property;
+	}
+	else
+	{
+		release_value(value);
+		value.property = BasicAllocator::create<Property<V>>(allocator, property);
+		value.type = &detail::PropertyType<V>::TAG;
+		value.assign = &assign<V>;
+#ifndef BMASHINA_DISABLE_DEBUG
+		value.print = &print<V>;
 #endif
 	}
 }
 
+template <typename M>
+template <typename V>
+void bmashina::BasicState<M>::assign(const Value& source, Value& destination)
+{
+	*static_cast<Property<V>*>(destination.property) = *static_cast<const Property<V>*>(source.property);
+}
+
 template <typename M>
 void bmashina::BasicState<M>::remove_value(const detail::BaseReference* key)
 {
-	auto iter = values.find(key);
-	if (iter != values.end() && iter->second != nullptr)
+	auto page = key->slot / PAGE_SIZE;
+	if (page >= pages.size() || pages[page] == nullptr)
+	{
+		return;
+	}
+
+	auto& value = pages[page]->values[key->slot % PAGE_SIZE];
+	if (value.reference == key)
 	{
-		BasicAllocator::destroy<detail::BaseProperty>(allocator, iter->second);
-		value_printers.erase(key);
-		values.erase(iter);
+		reset_value(value);
 	}
 }
 
 #ifndef BMASHINA_DISABLE_DEBUG
 #include <cstdio>
 
+template <typename M>
+template <typename V>
+typename bmashina::BasicState<M>::StringType
+bmashina::BasicState<M>::print(Mashina& mashina, const Value& value)
+{
+	if (value.property == nullptr)
+	{
+		return PropertyPrinter<Mashina, V>::print(mashina, Property<V>(load<V>(value)));
+	}
+
+	return PropertyPrinter<Mashina, V>::print(mashina, *static_cast<const Property<V>*>(value.property));
+}
+
 template <typename M>
 void bmashina::BasicState<M>::for_each_property(const PropertyIter& callback)
 {
-	for (auto& i: values)
+	for (auto page: pages)
 	{
-		auto reference = i.first;
-		typename String<M>::Type value;
+		if (page == nullptr)
 		{
-			auto iter = value_printers.find(reference);
-			if (iter != value_printers.end() && i.second != nullptr )
+			continue;
+		}
+
+		for (auto& i: page->values)
+		{
+			auto reference = i.reference;
+			if (reference == nullptr || is_stale(i))
 			{
-				value = iter->second(mashina, *this, reference);
+				continue;
 			}
-			else
+
+			typename String<M>::Type value;
 			{
-				if (i.second == nullptr)
+				if (i.print != nullptr && i.type != nullptr)
 				{
-					value = String<M>::construct(mashina, "(null)");
+					value = i.print(mashina, i);
 				}
 				else
 				{
-					value = String<M>::construct(mashina, "(unknown)");
+					if (i.type == nullptr)
+					{
+						value = String<M>::construct(mashina, "(null)");
+					}
+					else
+					{
+						value = String<M>::construct(mashina, "(unknown)");
+					}
 				}
 			}
-		}
 
-		if (reference->name == nullptr)
-		{
-			char name[32];
-			std::snprintf(name, sizeof(name), "%p", reference);
+			if (reference->name == nullptr)
+			{
+				char name[32];
+				std::snprintf(name, sizeof(name), "%p", reference);
 
-			callback(String<M>::construct(mashina, name), value);
-		}
-		else
-		{
-			callback(String<M>::construct(mashina, reference->name), value);
+				callback(String<M>::construct(mashina, name), value);
+			}
+			else
+			{
+				callback(String<M>::construct(mashina, reference->name), value);
+			}
 		}
 	}
 }
@@ -0,0 +1,227 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TRACE_CHROME_TRACE_HPP
+#define BMASHINA_TRACE_CHROME_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "bmashina/status.hpp"
+#include "bmashina/trace/traceRing.hpp"
+
+namespace bmashina
+{
+	// Writes a TraceRing dump as Chrome trace event JSON, which both
+	// chrome://tracing and Perfetto open. Each ring becomes a thread; trees
+	// and nodes become nested duration slices, with the node's status as an
+	// argument of the slice. Node slices are named after the tree they were
+	// entered in and their ordinal in it; nodes whose tree was entered before
+	// the oldest event in the ring are named by ordinal only. Timestamps are
+	// microseconds since the earliest event in the dump.
+	//
+	// Returns false if the dump is malformed; output may be incomplete then.
+	bool write_chrome_trace(const void* data, std::size_t size, std::FILE* file);
+
+	namespace detail
+	{
+		inline const char* get_trace_status_name(int status)
+		{
+			switch ((Status)status)
+			{
+				case Status::success:
+					return "success";
+				case Status::failure:
+					return "failure";
+				case Status::working:
+					return "working";
+				default:
+					return "none";
+			}
+		}
+
+		// Reads fields from the dump without assuming alignment.
+		class TraceDumpReader
+		{
+		public:
+			TraceDumpReader(const void* data, std::size_t size) :
+				data(static_cast<const unsigned char*>(data)),
+				size(size)
+			{
+				// Nothing.
+			}
+
+			template <typename T>
+			bool read(T& value)
+			{
+				if (size - offset < sizeof(T))
+				{
+					return false;
+				}
+
+				std::memcpy(&value, data + offset, sizeof(T));
+				offset += sizeof(T);
+
+				return true;
+			}
+
+			bool skip(std::size_t count)
+			{
+				if (size - offset < count)
+				{
+					return false;
+				}
+
+				offset += count;
+				return true;
+			}
+
+			std::size_t tell() const
+			{
+				return offset;
+			}
+
+			void seek(std::size_t value)
+			{
+				offset = value;
+			}
+
+		private:
+			const unsigned char* data;
+			std::size_t size;
+			std::size_t offset = 0;
+		};
+	}
+}
+
+inline bool bmashina::write_chrome_trace(const void* data, std::size_t size, std::FILE* file)
+{
+	detail::TraceDumpReader reader(data, size);
+
+	std::uint32_t header[4];
+	double frequency;
+	if (!reader.read(header) || !reader.read(frequency) ||
+		header[0] != TraceRing::dump_magic ||
+		header[1] != TraceRing::dump_version ||
+		!(frequency > 0))
+	{
+		return false;
+	}
+
+	// First pass finds the earliest timestamp and validates the sizes.
+	auto rings = reader.tell();
+	auto base = std::numeric_limits<std::uint64_t>::max();
+	for (std::uint32_t i = 0; i < header[2]; ++i)
+	{
+		std::uint32_t ring_header[2];
+		if (!reader.read(ring_header))
+		{
+			return false;
+		}
+
+		for (std::uint32_t j = 0; j < ring_header[1]; ++j)
+		{
+			TraceEvent event;
+			if (!reader.read(event))
+			{
+				return false;
+			}
+
+			if (event.timestamp < base)
+			{
+				base = event.timestamp;
+			}
+		}
+	}
+
+	std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	bool first = true;
+	std::vector<unsigned long long> trees;
+	reader.seek(rings);
+	for (std::uint32_t i = 0; i < header[2]; ++i)
+	{
+		std::uint32_t ring_header[2];
+		reader.read(ring_header);
+
+		auto thread = ring_header[0];
+		std::fprintf(
+			file,
+			"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			"\"args\":{\"name\":\"bmashina %u\"}}",
+			first ? "" : ",\n", thread, thread);
+		first = false;
+
+		trees.clear();
+		for (std::uint32_t j = 0; j < ring_header[1]; ++j)
+		{
+			TraceEvent event;
+			reader.read(event);
+
+			double time = (double)(event.timestamp - base) / frequency * 1e6;
+			auto object = (unsigned long long)event.object;
+			switch (event.type)
+			{
+				case trace_event_tree_enter:
+				case trace_event_tree_leave:
+					if (event.type == trace_event_tree_enter)
+					{
+						trees.push_back(object);
+					}
+					else if (!trees.empty())
+					{
+						trees.pop_back();
+					}
+
+					std::fprintf(
+						file,
+						",\n{\"name\":\"tree 0x%llx\",\"cat\":\"tree\",\"ph\":\"%c\",\"ts\":%.3f,"
+						"\"pid\":1,\"tid\":%u,\"args\":{\"depth\":%u}}",
+						object, event.type == trace_event_tree_enter ? 'B' : 'E',
+						time, thread, (unsigned)event.depth);
+					break;
+				case trace_event_node_enter:
+				case trace_event_node_leave:
+					std::fprintf(file, ",\n{\"name\":\"");
+					if (!trees.empty())
+					{
+						std::fprintf(file, "tree 0x%llx ", trees.back());
+					}
+					std::fprintf(
+						file,
+						"node %u\",\"cat\":\"node\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,",
+						(unsigned)event.ordinal,
+						event.type == trace_event_node_enter ? 'B' : 'E',
+						time, thread);
+					if (event.type == trace_event_node_enter)
+					{
+						std::fprintf(
+							file,
+							"\"args\":{\"node\":\"0x%llx\",\"depth\":%u}}",
+							object, (unsigned)event.depth);
+					}
+					else
+					{
+						std::fprintf(
+							file,
+							"\"args\":{\"status\":\"%s\"}}",
+							detail::get_trace_status_name(event.status));
+					}
+					break;
+			}
+		}
+	}
+
+	std::fprintf(file, "\n]}\n");
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,357 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TRACE_PROFILE_TRACER_HPP
+#define BMASHINA_TRACE_PROFILE_TRACER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include "bmashina/config.hpp"
+#include "bmashina/executor.hpp"
+#include "bmashina/node.hpp"
+#include "bmashina/status.hpp"
+#include "bmashina/tree.hpp"
+#include "bmashina/trace/traceRing.hpp"
+
+namespace bmashina
+{
+	struct NodeProfile
+	{
+		// Times the node was entered by the executor, either to be updated or
+		// visited (which returns Status::none).
+		std::uint64_t visits = 0;
+
+		// Timestamp ticks spent in the node, with and without the nodes
+		// (including those of other trees) entered from it. See
+		// get_trace_frequency.
+		std::uint64_t inclusive = 0;
+		std::uint64_t exclusive = 0;
+
+		// Visits by returned status, indexed by Status. Visits that did not
+		// update the node are counted under Status::none.
+		std::uint64_t statuses[4] = {};
+
+		std::uint64_t activations = 0;
+		std::uint64_t deactivations = 0;
+	};
+
+	// Accumulates a NodeProfile for every node the executor enters, keyed by
+	// tree and node ordinal. Enable it per Mashina type:
+	//
+	//     template <>
+	//     struct bmashina::Tracer<Agent>
+	//     {
+	//         typedef bmashina::ProfileTracer<Agent> Type;
+	//     };
+	//
+	// and read the results through executor.get_tracer(). Profiles are kept
+	// until reset; reset a tree before destroying it.
+	template <typename M>
+	class ProfileTracer
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicNode<Mashina> Node;
+
+		ProfileTracer(Mashina& mashina);
+
+		// Changes made in the middle of a tick may skew the nodes being
+		// executed; they are consistent from the next tick on.
+		void set_enabled(bool value);
+		bool get_enabled() const;
+
+		// Returns null if the node has not been entered or activated.
+		const NodeProfile* get_profile(const Node& node) const;
+		const NodeProfile* get_profile(const Tree& tree, std::size_t ordinal) const;
+
+		void reset();
+		void reset(const Tree& tree);
+
+		// Writes a table of the profiled nodes of tree, with a column per
+		// status (including none, for visits without an update) and times in
+		// microseconds.
+		void dump(const Tree& tree, std::FILE* file) const;
+
+		void before_enter_tree(Executor& executor, Tree* tree);
+		void after_enter_tree(Executor& executor, Tree* tree);
+		void before_leave_tree(Executor& executor, Tree* tree);
+		void after_leave_tree(Executor& executor, Tree* tree);
+		void before_update_node(Executor& executor, Node& node);
+		void after_update_node(Executor& executor, Node& node, Status status);
+		void activated_node(Executor& executor, const Node& node);
+		void deactivated_node(Executor& executor, const Node& node);
+
+	private:
+		Mashina* mashina;
+		bool enabled = true;
+
+		typedef Vector<Mashina, NodeProfile> Profiles;
+		typedef UnorderedMap<Mashina, const Tree*, typename Profiles::Type> ProfilesByTree;
+		typename ProfilesByTree::Type profiles;
+		const Tree* profile_tree = nullptr;
+		typename Profiles::Type* profile_tree_profiles = nullptr;
+
+		NodeProfile& profile(const Tree& tree, std::size_t ordinal);
+
+		// Nodes currently entered. Profiles are found again on leave, since
+		// entering a node may grow its tree's profiles.
+		struct Frame
+		{
+			typename Profiles::Type* profiles;
+			std::size_t ordinal;
+			std::uint64_t start;
+			std::uint64_t children;
+		};
+		typedef Vector<Mashina, Frame> Frames;
+		typename Frames::Type frames;
+	};
+}
+
+template <typename M>
+bmashina::ProfileTracer<M>::ProfileTracer(Mashina& mashina) :
+	mashina(&mashina),
+	profiles(ProfilesByTree::construct(mashina)),
+	frames(Frames::construct(mashina))
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::set_enabled(bool value)
+{
+	enabled = value;
+}
+
+template <typename M>
+bool bmashina::ProfileTracer<M>::get_enabled() const
+{
+	return enabled;
+}
+
+template <typename M>
+const bmashina::NodeProfile* bmashina::ProfileTracer<M>::get_profile(const Node& node) const
+{
+	return get_profile(node.tree(), node.ordinal());
+}
+
+template <typename M>
+const bmashina::NodeProfile* bmashina::ProfileTracer<M>::get_profile(
+	const Tree& tree,
+	std::size_t ordinal) const
+{
+	auto iter = profiles.find(&tree);
+	if (iter == profiles.end() || ordinal >= iter->second.size())
+	{
+		return nullptr;
+	}
+
+	auto& profile = iter->second[ordinal];
+	if (profile.visits == 0 && profile.activations == 0 && profile.deactivations == 0)
+	{
+		return nullptr;
+	}
+
+	return &profile;
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::reset()
+{
+	profiles.clear();
+	profile_tree = nullptr;
+	profile_tree_profiles = nullptr;
+	frames.clear();
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::reset(const Tree& tree)
+{
+	auto iter = profiles.find(&tree);
+	if (iter == profiles.end())
+	{
+		return;
+	}
+
+	for (auto& frame: frames)
+	{
+		if (frame.profiles == &iter->second)
+		{
+			frame.profiles = nullptr;
+		}
+	}
+
+	if (profile_tree == &tree)
+	{
+		profile_tree = nullptr;
+		profile_tree_profiles = nullptr;
+	}
+
+	profiles.erase(iter);
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::dump(const Tree& tree, std::FILE* file) const
+{
+	auto frequency = get_trace_frequency();
+
+	std::fprintf(file, "tree %p\n", (const void*)&tree);
+	std::fprintf(
+		file,
+		"%8s %10s %10s %10s %10s %10s %10s %12s %14s %14s\n",
+		"node", "visits", "none", "success", "failure", "working",
+		"activated", "deactivated", "inclusive_us", "exclusive_us");
+
+	auto iter = profiles.find(&tree);
+	if (iter == profiles.end())
+	{
+		return;
+	}
+
+	for (std::size_t i = 0; i < iter->second.size(); ++i)
+	{
+		auto& profile = iter->second[i];
+		if (profile.visits == 0 && profile.activations == 0 && profile.deactivations == 0)
+		{
+			continue;
+		}
+
+		std::fprintf(
+			file,
+			"%8zu %10llu %10llu %10llu %10llu %10llu %10llu %12llu %14.3f %14.3f\n",
+			i,
+			(unsigned long long)profile.visits,
+			(unsigned long long)profile.statuses[(int)Status::none],
+			(unsigned long long)profile.statuses[(int)Status::success],
+			(unsigned long long)profile.statuses[(int)Status::failure],
+			(unsigned long long)profile.statuses[(int)Status::working],
+			(unsigned long long)profile.activations,
+			(unsigned long long)profile.deactivations,
+			profile.inclusive / frequency * 1e6,
+			profile.exclusive / frequency * 1e6);
+	}
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::before_enter_tree(Executor& executor, Tree* tree)
+{
+	// Nodes left entered by an exception thrown in a previous tick.
+	if (executor.get_current_depth() == 0)
+	{
+		frames.clear();
+	}
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::after_enter_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::before_leave_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::after_leave_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::before_update_node(Executor& executor, Node& node)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	++profile(node.tree(), node.ordinal()).visits;
+
+	frames.push_back({ profile_tree_profiles, node.ordinal(), 0, 0 });
+	frames.back().start = read_trace_timestamp();
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::after_update_node(
+	Executor& executor,
+	Node& node,
+	Status status)
+{
+	auto stop = read_trace_timestamp();
+
+	if (!enabled || frames.empty())
+	{
+		return;
+	}
+
+	auto frame = frames.back();
+	frames.pop_back();
+
+	auto elapsed = stop - frame.start;
+	if (!frames.empty())
+	{
+		frames.back().children += elapsed;
+	}
+
+	if (frame.profiles != nullptr)
+	{
+		auto& result = (*frame.profiles)[frame.ordinal];
+		result.inclusive += elapsed;
+		result.exclusive += elapsed - frame.children;
+		++result.statuses[(int)status];
+	}
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::activated_node(Executor& executor, const Node& node)
+{
+	if (enabled)
+	{
+		++profile(node.tree(), node.ordinal()).activations;
+	}
+}
+
+template <typename M>
+void bmashina::ProfileTracer<M>::deactivated_node(Executor& executor, const Node& node)
+{
+	if (enabled)
+	{
+		++profile(node.tree(), node.ordinal()).deactivations;
+	}
+}
+
+template <typename M>
+bmashina::NodeProfile& bmashina::ProfileTracer<M>::profile(
+	const Tree& tree,
+	std::size_t ordinal)
+{
+	if (profile_tree != &tree)
+	{
+		auto iter = profiles.find(&tree);
+		if (iter == profiles.end())
+		{
+			iter = profiles.emplace(&tree, Profiles::construct(*mashina)).first;
+		}
+
+		profile_tree = &tree;
+		profile_tree_profiles = &iter->second;
+	}
+
+	if (ordinal >= profile_tree_profiles->size())
+	{
+		profile_tree_profiles->resize(ordinal + 1);
+	}
+
+	return (*profile_tree_profiles)[ordinal];
+}
+
+#endif
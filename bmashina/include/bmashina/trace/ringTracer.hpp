@@ -0,0 +1,147 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TRACE_RING_TRACER_HPP
+#define BMASHINA_TRACE_RING_TRACER_HPP
+
+#include "bmashina/config.hpp"
+#include "bmashina/executor.hpp"
+#include "bmashina/node.hpp"
+#include "bmashina/status.hpp"
+#include "bmashina/tree.hpp"
+#include "bmashina/trace/traceRing.hpp"
+
+namespace bmashina
+{
+	// Records tree and node enter/leave events into the TraceRing of the
+	// thread running the executor. Enable it per Mashina type:
+	//
+	//     template <>
+	//     struct bmashina::Tracer<Agent>
+	//     {
+	//         typedef bmashina::RingTracer<Agent> Type;
+	//     };
+	template <typename M>
+	class RingTracer
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicNode<Mashina> Node;
+
+		RingTracer(Mashina& mashina);
+
+		// Recording can be paused without changing the tracer type.
+		void set_enabled(bool value);
+		bool get_enabled() const;
+
+		void before_enter_tree(Executor& executor, Tree* tree);
+		void after_enter_tree(Executor& executor, Tree* tree);
+		void before_leave_tree(Executor& executor, Tree* tree);
+		void after_leave_tree(Executor& executor, Tree* tree);
+		void before_update_node(Executor& executor, Node& node);
+		void after_update_node(Executor& executor, Node& node, Status status);
+		void activated_node(Executor& executor, const Node& node);
+		void deactivated_node(Executor& executor, const Node& node);
+
+	private:
+		bool enabled = true;
+	};
+}
+
+template <typename M>
+bmashina::RingTracer<M>::RingTracer(Mashina& mashina)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::set_enabled(bool value)
+{
+	enabled = value;
+}
+
+template <typename M>
+bool bmashina::RingTracer<M>::get_enabled() const
+{
+	return enabled;
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::before_enter_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::after_enter_tree(Executor& executor, Tree* tree)
+{
+	if (enabled)
+	{
+		TraceRing::local().record(
+			trace_event_tree_enter, tree, 0,
+			executor.get_current_depth(), (int)Status::none);
+	}
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::before_leave_tree(Executor& executor, Tree* tree)
+{
+	if (enabled)
+	{
+		TraceRing::local().record(
+			trace_event_tree_leave, tree, 0,
+			executor.get_current_depth(), (int)Status::none);
+	}
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::after_leave_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::before_update_node(Executor& executor, Node& node)
+{
+	if (enabled)
+	{
+		TraceRing::local().record(
+			trace_event_node_enter, &node, (std::uint32_t)node.ordinal(),
+			executor.get_current_depth(), (int)Status::none);
+	}
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::after_update_node(
+	Executor& executor,
+	Node& node,
+	Status status)
+{
+	if (enabled)
+	{
+		TraceRing::local().record(
+			trace_event_node_leave, &node, (std::uint32_t)node.ordinal(),
+			executor.get_current_depth(), (int)status);
+	}
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::activated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::RingTracer<M>::deactivated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+
+#endif
@@ -0,0 +1,351 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TRACE_TRACE_RING_HPP
+#define BMASHINA_TRACE_TRACE_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BMASHINA_TRACE_RDTSC
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#define BMASHINA_TRACE_RDTSC
+#include <intrin.h>
+#endif
+
+namespace bmashina
+{
+	enum
+	{
+		trace_event_tree_enter = 1,
+		trace_event_tree_leave,
+		trace_event_node_enter,
+		trace_event_node_leave
+	};
+
+	// One recorded event. This is also the record layout of a trace dump.
+	struct TraceEvent
+	{
+		// Raw timestamp; see get_trace_frequency.
+		std::uint64_t timestamp;
+
+		// Address of the tree or node.
+		std::uint64_t object;
+
+		// Ordinal of the node in its tree. Zero for tree events.
+		std::uint32_t ordinal;
+
+		// Executor depth at the time of the event.
+		std::uint16_t depth;
+
+		std::uint8_t type;
+
+		// Status returned by the node, for node leave events.
+		std::uint8_t status;
+	};
+	static_assert(sizeof(TraceEvent) == 24, "TraceEvent must be 24 bytes");
+
+	// Timestamps are TSC ticks on x86 and nanoseconds elsewhere.
+	std::uint64_t read_trace_timestamp();
+
+	// Timestamp ticks per second. Calibrated against the steady clock on
+	// first use, which takes a few milliseconds.
+	double get_trace_frequency();
+
+	// A fixed-size ring of events written by a single thread. Recording is
+	// wait-free: each event is a few relaxed stores followed by a release
+	// store of the write position. Other threads can take a snapshot at any
+	// time; events overwritten while the snapshot is copied are discarded.
+	//
+	// Every ring registers itself, so TraceRing::dump collects the rings of
+	// all threads. TraceRing::local is the calling thread's ring; it is
+	// destroyed, and its events lost, when the thread exits.
+	//
+	// A dump is a header followed by each ring's events:
+	//
+	//     uint32 magic ('BMTR'), uint32 version, uint32 num_rings,
+	//     uint32 reserved, double frequency
+	//     num_rings x { uint32 thread, uint32 num_events,
+	//                   num_events x TraceEvent }
+	class TraceRing
+	{
+	public:
+		static constexpr std::size_t DEFAULT_CAPACITY = 1 << 14;
+
+		enum
+		{
+			dump_magic = 0x52544d42, // 'BMTR'
+			dump_version = 1
+		};
+
+		// Capacity is rounded up to a power of two.
+		explicit TraceRing(std::size_t capacity = DEFAULT_CAPACITY);
+		TraceRing(const TraceRing& other) = delete;
+		~TraceRing();
+
+		static TraceRing& local();
+
+		void record(
+			int type,
+			const void* object,
+			std::uint32_t ordinal,
+			std::size_t depth,
+			int status);
+
+		// Drops the events recorded so far. Only the owning thread may clear
+		// the ring.
+		void clear();
+
+		// Appends the events currently in the ring, oldest first.
+		void snapshot(std::vector<TraceEvent>& result) const;
+
+		std::size_t get_capacity() const;
+		std::uint32_t get_thread() const;
+
+		static void dump(std::vector<unsigned char>& result);
+		static bool save(const char* filename);
+
+		TraceRing& operator =(const TraceRing& other) = delete;
+
+	private:
+		// An event is stored as three words so that snapshots never read a
+		// partially written word.
+		struct Slot
+		{
+			std::atomic<std::uint64_t> timestamp;
+			std::atomic<std::uint64_t> object;
+			std::atomic<std::uint64_t> packed;
+		};
+
+		Slot* slots;
+		std::size_t mask;
+		std::atomic<std::uint64_t> head;
+		std::atomic<std::uint64_t> tail;
+		std::uint32_t thread;
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<TraceRing*> rings;
+			std::uint32_t next_thread = 0;
+		};
+		static Registry& registry();
+	};
+}
+
+inline std::uint64_t bmashina::read_trace_timestamp()
+{
+#ifdef BMASHINA_TRACE_RDTSC
+	return __rdtsc();
+#else
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+inline double bmashina::get_trace_frequency()
+{
+#ifdef BMASHINA_TRACE_RDTSC
+	static const double frequency = []
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		auto start_time = Clock::now();
+		auto start = read_trace_timestamp();
+		while (Clock::now() - start_time < std::chrono::milliseconds(10))
+		{
+			// Nothing.
+		}
+		auto stop = read_trace_timestamp();
+		auto stop_time = Clock::now();
+
+		std::chrono::duration<double> elapsed = stop_time - start_time;
+		return (double)(stop - start) / elapsed.count();
+	}();
+
+	return frequency;
+#else
+	return 1e9;
+#endif
+}
+
+inline bmashina::TraceRing::TraceRing(std::size_t capacity) :
+	head(0),
+	tail(0)
+{
+	std::size_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	slots = new Slot[size];
+	mask = size - 1;
+
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	thread = r.next_thread++;
+	r.rings.push_back(this);
+}
+
+inline bmashina::TraceRing::~TraceRing()
+{
+	{
+		auto& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.rings.erase(std::remove(r.rings.begin(), r.rings.end(), this), r.rings.end());
+	}
+
+	delete[] slots;
+}
+
+inline bmashina::TraceRing& bmashina::TraceRing::local()
+{
+	static thread_local TraceRing ring;
+	return ring;
+}
+
+inline void bmashina::TraceRing::record(
+	int type,
+	const void* object,
+	std::uint32_t ordinal,
+	std::size_t depth,
+	int status)
+{
+	auto index = head.load(std::memory_order_relaxed);
+	auto& slot = slots[index & mask];
+
+	// Pairs with the acquire fence in snapshot: a reader that sees any of
+	// the stores below also sees head >= index.
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::uint64_t packed = ordinal;
+	packed |= (std::uint64_t)(std::min<std::size_t>(depth, 0xffff)) << 32;
+	packed |= (std::uint64_t)(type & 0xff) << 48;
+	packed |= (std::uint64_t)(status & 0xff) << 56;
+
+	slot.timestamp.store(read_trace_timestamp(), std::memory_order_relaxed);
+	slot.object.store((std::uint64_t)(std::uintptr_t)object, std::memory_order_relaxed);
+	slot.packed.store(packed, std::memory_order_relaxed);
+
+	head.store(index + 1, std::memory_order_release);
+}
+
+inline void bmashina::TraceRing::clear()
+{
+	tail.store(head.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+inline void bmashina::TraceRing::snapshot(std::vector<TraceEvent>& result) const
+{
+	auto capacity = (std::uint64_t)get_capacity();
+	auto end = head.load(std::memory_order_acquire);
+	auto begin = std::max<std::uint64_t>(
+		end > capacity ? end - capacity : 0,
+		tail.load(std::memory_order_acquire));
+
+	auto offset = result.size();
+	for (auto i = begin; i < end; ++i)
+	{
+		auto& slot = slots[i & mask];
+		auto packed = slot.packed.load(std::memory_order_relaxed);
+
+		TraceEvent event;
+		event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+		event.object = slot.object.load(std::memory_order_relaxed);
+		event.ordinal = (std::uint32_t)packed;
+		event.depth = (std::uint16_t)(packed >> 32);
+		event.type = (std::uint8_t)(packed >> 48);
+		event.status = (std::uint8_t)(packed >> 56);
+		result.push_back(event);
+	}
+
+	// The writer may have lapped the oldest events while they were copied,
+	// and may be in the middle of overwriting the slot of index
+	// current - capacity.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	auto current = head.load(std::memory_order_relaxed);
+	if (current + 1 > capacity && current + 1 - capacity > begin)
+	{
+		auto torn = std::min<std::uint64_t>(current + 1 - capacity - begin, end - begin);
+		result.erase(result.begin() + offset, result.begin() + offset + torn);
+	}
+}
+
+inline std::size_t bmashina::TraceRing::get_capacity() const
+{
+	return mask + 1;
+}
+
+inline std::uint32_t bmashina::TraceRing::get_thread() const
+{
+	return thread;
+}
+
+inline void bmashina::TraceRing::dump(std::vector<unsigned char>& result)
+{
+	auto append = [&result](const void* data, std::size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*>(data);
+		result.insert(result.end(), bytes, bytes + size);
+	};
+
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+
+	std::uint32_t header[4] = { dump_magic, dump_version, (std::uint32_t)r.rings.size(), 0 };
+	double frequency = get_trace_frequency();
+
+	result.clear();
+	append(header, sizeof(header));
+	append(&frequency, sizeof(frequency));
+
+	std::vector<TraceEvent> events;
+	for (auto ring: r.rings)
+	{
+		events.clear();
+		ring->snapshot(events);
+
+		std::uint32_t ring_header[2] = { ring->get_thread(), (std::uint32_t)events.size() };
+		append(ring_header, sizeof(ring_header));
+		append(events.data(), events.size() * sizeof(TraceEvent));
+	}
+}
+
+inline bool bmashina::TraceRing::save(const char* filename)
+{
+	std::vector<unsigned char> result;
+	dump(result);
+
+	std::FILE* file = std::fopen(filename, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool success = std::fwrite(result.data(), 1, result.size(), file) == result.size();
+	success = (std::fclose(file) == 0) && success;
+
+	return success;
+}
+
+inline bmashina::TraceRing::Registry& bmashina::TraceRing::registry()
+{
+	static Registry instance;
+	return instance;
+}
+
+#endif
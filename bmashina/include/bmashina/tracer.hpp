@@ -0,0 +1,254 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TRACER_HPP
+#define BMASHINA_TRACER_HPP
+
+#include "bmashina/config.hpp"
+#include "bmashina/status.hpp"
+
+namespace bmashina
+{
+	template <typename M>
+	class BasicTree;
+
+	template <typename M>
+	class BasicNode;
+
+	template <typename M>
+	class BasicExecutor;
+
+	// Tracers are called by BasicExecutor around every tree and node it
+	// enters and leaves. The tracer type is chosen at compile time through
+	// Tracer<M>::Type, so the calls are direct and inlined; a tracer must
+	// provide the same members as NullTracer.
+	//
+	// The tree passed to before_enter_tree and after_leave_tree is the tree
+	// being executed around the call, or null at the top level.
+	// activated_node and deactivated_node are called when the executor marks
+	// a node active or inactive.
+	template <typename M>
+	class NullTracer
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicNode<Mashina> Node;
+
+		NullTracer(Mashina& mashina);
+
+		void before_enter_tree(Executor& executor, Tree* tree);
+		void after_enter_tree(Executor& executor, Tree* tree);
+		void before_leave_tree(Executor& executor, Tree* tree);
+		void after_leave_tree(Executor& executor, Tree* tree);
+		void before_update_node(Executor& executor, Node& node);
+		void after_update_node(Executor& executor, Node& node, Status status);
+		void activated_node(Executor& executor, const Node& node);
+		void deactivated_node(Executor& executor, const Node& node);
+	};
+
+#ifndef BMASHINA_DISABLE_DEBUG
+	template <typename M>
+	class BasicPreview
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicNode<Mashina> Node;
+
+		virtual ~BasicPreview() = default;
+
+		virtual void before_enter_tree(Tree* tree) = 0;
+		virtual void after_enter_tree(Tree* tree) = 0;
+		virtual void before_leave_tree(Tree* tree) = 0;
+		virtual void after_leave_tree(Tree* tree) = 0;
+		virtual void before_update_node(Node& node) = 0;
+		virtual void after_update_node(Node& node, Status status) = 0;
+	};
+
+	// Forwards to a BasicPreview set at runtime, if any. The default tracer
+	// unless BMASHINA_DISABLE_DEBUG is defined.
+	template <typename M>
+	class PreviewTracer
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicNode<Mashina> Node;
+		typedef BasicPreview<Mashina> Preview;
+
+		PreviewTracer(Mashina& mashina);
+
+		Preview* get_preview() const;
+		void set_preview(Preview* value);
+
+		void before_enter_tree(Executor& executor, Tree* tree);
+		void after_enter_tree(Executor& executor, Tree* tree);
+		void before_leave_tree(Executor& executor, Tree* tree);
+		void after_leave_tree(Executor& executor, Tree* tree);
+		void before_update_node(Executor& executor, Node& node);
+		void after_update_node(Executor& executor, Node& node, Status status);
+		void activated_node(Executor& executor, const Node& node);
+		void deactivated_node(Executor& executor, const Node& node);
+
+	private:
+		Preview* preview = nullptr;
+	};
+#endif
+}
+
+template <typename M>
+bmashina::NullTracer<M>::NullTracer(Mashina& mashina)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::before_enter_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::after_enter_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::before_leave_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::after_leave_tree(Executor& executor, Tree* tree)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::before_update_node(Executor& executor, Node& node)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::after_update_node(
+	Executor& executor,
+	Node& node,
+	Status status)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::activated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::NullTracer<M>::deactivated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+
+#ifndef BMASHINA_DISABLE_DEBUG
+template <typename M>
+bmashina::PreviewTracer<M>::PreviewTracer(Mashina& mashina)
+{
+	// Nothing.
+}
+
+template <typename M>
+typename bmashina::PreviewTracer<M>::Preview*
+bmashina::PreviewTracer<M>::get_preview() const
+{
+	return preview;
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::set_preview(Preview* value)
+{
+	preview = value;
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::before_enter_tree(Executor& executor, Tree* tree)
+{
+	if (preview != nullptr)
+	{
+		preview->before_enter_tree(tree);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::after_enter_tree(Executor& executor, Tree* tree)
+{
+	if (preview != nullptr)
+	{
+		preview->after_enter_tree(tree);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::before_leave_tree(Executor& executor, Tree* tree)
+{
+	if (preview != nullptr)
+	{
+		preview->before_leave_tree(tree);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::after_leave_tree(Executor& executor, Tree* tree)
+{
+	if (preview != nullptr)
+	{
+		preview->after_leave_tree(tree);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::before_update_node(Executor& executor, Node& node)
+{
+	if (preview != nullptr)
+	{
+		preview->before_update_node(node);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::after_update_node(
+	Executor& executor,
+	Node& node,
+	Status status)
+{
+	if (preview != nullptr)
+	{
+		preview->after_update_node(node, status);
+	}
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::activated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+
+template <typename M>
+void bmashina::PreviewTracer<M>::deactivated_node(Executor& executor, const Node& node)
+{
+	// Nothing.
+}
+#endif
+
+#endif
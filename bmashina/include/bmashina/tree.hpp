@@ -17,6 +17,7 @@
 #include "bmashina/executor.hpp"
 #include "bmashina/node.hpp"
 #include "bmashina/status.hpp"
+#include "bmashina/treeInstance.hpp"
 #include "bmashina/state/state.hpp"
 
 #ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
@@ -37,6 +38,7 @@ namespace bmashina
 		typedef BasicNode<Mashina> Node;
 		typedef BasicComposite<Mashina> Composite;
 		typedef BasicDecorator<Mashina> Decorator;
+		typedef BasicTreeInstance<Mashina> Instance;
 
 		BasicTree(Mashina& mashina);
 		BasicTree(const Tree& other) = delete;
@@ -47,6 +49,16 @@ namespace bmashina
 
 		template <typename V>
 		const Local<V>& constant(const Property<V>& value);
+		bool is_constant(const detail::BaseReference& reference) const;
+
+		// Like constant, but the value is stored as a V behind a Local<R>.
+		// See BasicState::set_as.
+		template <typename R, typename V>
+		const Local<R>& constant_as(const Property<V>& value);
+
+		// Values of the constants above. Executors read constants through
+		// this state rather than copying them in.
+		const State& get_constants() const;
 
 		void input(const detail::BaseReference& referece);
 		void input(
@@ -57,6 +69,13 @@ namespace bmashina
 			const Channel& channel,
 			const detail::BaseReference& from,
 			const detail::BaseReference& to);
+
+		// Returns the reference wired into to for node, or to if it is not
+		// one of node's inputs.
+		const detail::BaseReference& get_input_source(
+			const Node& node,
+			const detail::BaseReference& to) const;
+
 		void output(const detail::BaseReference& reference);
 		void output(
 			Node& node,
@@ -92,19 +111,28 @@ namespace bmashina
 		void clear();
 		bool empty() const;
 
+		void compile();
+		bool compiled() const;
+
 		Status execute(Executor& executor);
 
+		// Executes the tree on behalf of instance, whose channel assignments
+		// and constants override those of the tree.
+		Status execute(Executor& executor, const Instance& instance);
+
 		Status update(Executor& executor, Node& node);
 
 		Tree& operator =(const Tree& other) = delete;
 
 	private:
+		Status execute(Executor& executor, const Instance* instance);
+
 		void before_update(Executor& executor, Node& node);
 		void after_update(Executor& executor, Node& node, Status status);
 
 		Mashina mashina;
 
-		typedef typename Allocator<Mashina>::Type AllocatorType;
+		typedef typename TreeAllocator<Mashina>::Type AllocatorType;
 		AllocatorType allocator;
 
 		typedef UnorderedSet<Mashina, Node*> NodeSet;
@@ -132,11 +160,47 @@ namespace bmashina
 
 		typedef std::tuple<const detail::BaseReference*, const detail::BaseReference*> FromToTuple;
 		typedef Vector<Mashina, FromToTuple> WireList;
+		typename WireList::Type empty_wire_list;
 
 		typedef UnorderedMap<Mashina, Node*, typename WireList::Type> NodeWires;
 		typename NodeWires::Type node_inputs;
 		typename NodeWires::Type node_outputs;
 
+		// Compiled (frozen) structure. Nodes are laid out in preorder and the
+		// children of each node occupy a contiguous span of compiled_children,
+		// indexed by node ordinal. Input and output wires are flattened the
+		// same way. Any structural or wiring mutation drops back to the maps
+		// above until the tree is compiled again.
+		struct Span
+		{
+			std::size_t begin;
+			std::size_t end;
+		};
+		typedef Vector<Mashina, Span> SpanList;
+		typename SpanList::Type compiled_spans;
+		typename NodeList::Type compiled_nodes;
+		typename NodeList::Type compiled_children;
+		typename SpanList::Type compiled_input_spans;
+		typename WireList::Type compiled_inputs;
+		typename SpanList::Type compiled_output_spans;
+		typename WireList::Type compiled_outputs;
+		bool is_compiled = false;
+
+		void compile_node(Node& node);
+		void compile_wires(
+			const typename NodeWires::Type& wires,
+			typename SpanList::Type& spans,
+			typename WireList::Type& result);
+
+		typedef typename WireList::Type::const_iterator WireIterator;
+		void get_wires(
+			const Node& node,
+			const typename NodeWires::Type& wires,
+			const typename SpanList::Type& spans,
+			const typename WireList::Type& compiled,
+			WireIterator& begin,
+			WireIterator& end) const;
+
 		typedef UnorderedSet<Mashina, const detail::BaseReference*> ReferenceList;
 		typename ReferenceList::Type inputs;
 		typename ReferenceList::Type outputs;
@@ -196,8 +260,16 @@ bmashina::BasicTree<M>::BasicTree(Mashina& mashina) :
 	channel_nodes(ChannelNodes::construct(mashina)),
 	empty_node_list(NodeList::construct(mashina)),
 	children(NodeChildren::construct(mashina)),
+	empty_wire_list(WireList::construct(mashina)),
 	node_inputs(NodeWires::construct(mashina)),
 	node_outputs(NodeWires::construct(mashina)),
+	compiled_spans(SpanList::construct(mashina)),
+	compiled_nodes(NodeList::construct(mashina)),
+	compiled_children(NodeList::construct(mashina)),
+	compiled_input_spans(SpanList::construct(mashina)),
+	compiled_inputs(WireList::construct(mashina)),
+	compiled_output_spans(SpanList::construct(mashina)),
+	compiled_outputs(WireList::construct(mashina)),
 	inputs(ReferenceList::construct(mashina)),
 	outputs(ReferenceList::construct(mashina)),
 	locals(LocalSet::construct(mashina)),
@@ -363,11 +435,17 @@ void bmashina::BasicTree<M>::unassign(const Channel& channel)
 	node_inputs.erase(iter->second);
 	node_outputs.erase(iter->second);
 	channel_assignments.erase(channel);
+	is_compiled = false;
 }
 
 template <typename M>
 bool bmashina::BasicTree<M>::has(Node& node) const
 {
+	if (is_compiled)
+	{
+		return node.attached() && &node.tree() == this;
+	}
+
 	return nodes.count(&node) != 0;
 }
 
@@ -386,6 +464,14 @@ void bmashina::BasicTree<M>::clear()
 	}
 	nodes.clear();
 	children.clear();
+	compiled_spans.clear();
+	compiled_nodes.clear();
+	compiled_children.clear();
+	compiled_input_spans.clear();
+	compiled_inputs.clear();
+	compiled_output_spans.clear();
+	compiled_outputs.clear();
+	is_compiled = false;
 	node_inputs.clear();
 	node_outputs.clear();
 
@@ -398,8 +484,13 @@ void bmashina::BasicTree<M>::clear()
 	locals.clear();
 	inputs.clear();
 	outputs.clear();
-	constants.clear();
+
 	constant_values.clear();
+	for (auto constant: constants)
+	{
+		BasicAllocator::destroy<detail::BaseReference>(allocator, constant);
+	}
+	constants.clear();
 
 	channels.clear();
 	channel_assignments.clear();
@@ -412,23 +503,156 @@ bool bmashina::BasicTree<M>::empty() const
 	return nodes.empty();
 }
 
+template <typename M>
+void bmashina::BasicTree<M>::compile()
+{
+	compiled_spans.clear();
+	compiled_spans.resize(nodes.size(), Span { 0, 0 });
+	compiled_nodes.clear();
+	compiled_nodes.reserve(nodes.size());
+	compiled_children.clear();
+	compiled_children.reserve(nodes.size());
+
+	if (root_node != nullptr)
+	{
+		compile_node(*root_node);
+	}
+
+	compile_wires(node_inputs, compiled_input_spans, compiled_inputs);
+	compile_wires(node_outputs, compiled_output_spans, compiled_outputs);
+
+	is_compiled = true;
+}
+
+template <typename M>
+bool bmashina::BasicTree<M>::compiled() const
+{
+	return is_compiled;
+}
+
+template <typename M>
+void bmashina::BasicTree<M>::compile_node(Node& node)
+{
+	compiled_nodes.push_back(&node);
+
+	auto& span = compiled_spans[node.ordinal()];
+	span.begin = compiled_children.size();
+
+	auto iter = children.find(&node);
+	if (iter != children.end())
+	{
+		for (auto child: iter->second)
+		{
+			compiled_children.push_back(child);
+		}
+	}
+
+	span.end = compiled_children.size();
+
+	for (auto i = span.begin; i < span.end; ++i)
+	{
+		compile_node(*compiled_children[i]);
+	}
+}
+
+template <typename M>
+void bmashina::BasicTree<M>::compile_wires(
+	const typename NodeWires::Type& wires,
+	typename SpanList::Type& spans,
+	typename WireList::Type& result)
+{
+	spans.clear();
+	spans.resize(nodes.size(), Span { 0, 0 });
+	result.clear();
+
+	for (auto node: compiled_nodes)
+	{
+		auto& span = spans[node->ordinal()];
+		span.begin = result.size();
+
+		auto iter = wires.find(node);
+		if (iter != wires.end())
+		{
+			for (auto& wire: iter->second)
+			{
+				result.push_back(wire);
+			}
+		}
+
+		span.end = result.size();
+	}
+}
+
+template <typename M>
+void bmashina::BasicTree<M>::get_wires(
+	const Node& node,
+	const typename NodeWires::Type& wires,
+	const typename SpanList::Type& spans,
+	const typename WireList::Type& compiled,
+	WireIterator& begin,
+	WireIterator& end) const
+{
+	if (is_compiled)
+	{
+		auto& span = spans[node.ordinal()];
+		begin = compiled.begin() + span.begin;
+		end = compiled.begin() + span.end;
+		return;
+	}
+
+	auto iter = wires.find(const_cast<Node*>(&node));
+	if (iter == wires.end())
+	{
+		begin = empty_wire_list.begin();
+		end = empty_wire_list.end();
+	}
+	else
+	{
+		begin = iter->second.begin();
+		end = iter->second.end();
+	}
+}
+
 template <typename M>
 bmashina::Status bmashina::BasicTree<M>::execute(Executor& executor)
+{
+	return execute(executor, nullptr);
+}
+
+template <typename M>
+bmashina::Status bmashina::BasicTree<M>::execute(
+	Executor& executor,
+	const Instance& instance)
+{
+	assert(&instance.get_template() == this);
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (&instance.get_template() != this)
+	{
+		throw std::runtime_error("instance is not of this tree");
+	}
+#endif
+
+	return execute(executor, &instance);
+}
+
+template <typename M>
+bmashina::Status bmashina::BasicTree<M>::execute(
+	Executor& executor,
+	const Instance* instance)
 {
 	if (empty())
 	{
 		return Status::failure;
 	}
 
-	Status result;
-	executor.enter(*this);
-
-	auto& state = executor.state();
-	for (auto constant: constants)
+	if (executor.sleeping(*this, instance))
 	{
-		State::copy(constant_values, state, *constant);
+		return Status::working;
 	}
 
+	Status result;
+	executor.enter(*this, instance);
 	result = executor.update(*root_node);
 
 	executor.leave(*this);
@@ -458,17 +682,14 @@ void bmashina::BasicTree<M>::before_update(Executor& executor, Node& node)
 	executor.enter(node);
 	auto& state = executor.state();
 
-	auto iter = node_inputs.find(&node);
-	if (iter != node_inputs.end())
+	WireIterator begin, end;
+	get_wires(node, node_inputs, compiled_input_spans, compiled_inputs, begin, end);
+	for (auto i = begin; i != end; ++i)
 	{
-		auto& inputs = iter->second;
-		for (auto i: inputs)
-		{
-			auto from = std::get<0>(i);
-			auto to = std::get<1>(i);
+		auto from = std::get<0>(*i);
+		auto to = std::get<1>(*i);
 
-			State::copy(state, state, *from, *to);
-		}
+		State::copy_scratch(state, state, *from, *to);
 	}
 }
 
@@ -478,29 +699,21 @@ void bmashina::BasicTree<M>::after_update(Executor& executor, Node& node, Status
 	auto& state = executor.state();
 	executor.leave(node, status);
 
-	auto outputs_iter = node_outputs.find(&node);
-	if (outputs_iter != node_outputs.end())
+	WireIterator begin, end;
+	get_wires(node, node_outputs, compiled_output_spans, compiled_outputs, begin, end);
+	for (auto i = begin; i != end; ++i)
 	{
-		auto& outputs = outputs_iter->second;
-		for (auto i: outputs)
-		{
-			auto from = std::get<0>(i);
-			auto to = std::get<1>(i);
+		auto from = std::get<0>(*i);
+		auto to = std::get<1>(*i);
 
-			State::copy(state, state, *from, *to);
-			state.unset(*from);
-		}
+		State::move(state, *from, *to);
 	}
 
-	auto inputs_iter = node_inputs.find(&node);
-	if (inputs_iter != node_inputs.end())
+	get_wires(node, node_inputs, compiled_input_spans, compiled_inputs, begin, end);
+	for (auto i = begin; i != end; ++i)
 	{
-		auto& inputs = inputs_iter->second;
-		for (auto i: inputs)
-		{
-			auto to = std::get<1>(i);
-			state.unset(*to);
-		}
+		auto to = std::get<1>(*i);
+		state.unset(*to);
 	}
 }
 
@@ -517,6 +730,12 @@ bmashina::BasicTree<M>::children_begin(Node& parent)
 	}
 #endif
 
+	if (is_compiled)
+	{
+		auto& span = compiled_spans[parent.ordinal()];
+		return ChildrenIterator(compiled_children.begin() + span.begin);
+	}
+
 	if (children.count(&parent) == 0)
 	{
 		return empty_node_list.begin();
@@ -538,6 +757,12 @@ bmashina::BasicTree<M>::children_end(Node& parent)
 	}
 #endif
 
+	if (is_compiled)
+	{
+		auto& span = compiled_spans[parent.ordinal()];
+		return ChildrenIterator(compiled_children.begin() + span.end);
+	}
+
 	if (children.count(&parent) == 0)
 	{
 		return empty_node_list.end();
@@ -551,9 +776,12 @@ template <typename N, typename... Arguments>
 N* bmashina::BasicTree<M>::create(Arguments&&... arguments)
 {
 	auto node = BasicAllocator::create<N>(allocator, std::forward<Arguments>(arguments)...);
+	auto ordinal = nodes.size();
 	nodes.emplace(node);
 
-	node->attach(*this);
+	node->attach(*this, ordinal);
+	is_compiled = false;
+
 	return node;
 }
 
@@ -582,6 +810,16 @@ bmashina::BasicTree<M>::ChannelProxyNode::ChannelProxyNode(const Channel& channe
 template <typename M>
 bmashina::Status bmashina::BasicTree<M>::ChannelProxyNode::update(Executor& executor)
 {
+	auto instance = executor.get_instance();
+	if (instance != nullptr)
+	{
+		auto assignment = instance->get_assignment(channel);
+		if (assignment != nullptr && !assignment->empty())
+		{
+			return assignment->execute(executor);
+		}
+	}
+
 	auto& parent_tree = this->tree();
 	auto iter = parent_tree.channel_assignments.find(channel);
 	if (iter != parent_tree.channel_assignments.end() && !iter->second->empty())
@@ -627,12 +865,54 @@ const bmashina::Local<V>& bmashina::BasicTree<M>::constant(const Property<V>& va
 	return *reference;
 }
 
+template <typename M>
+template <typename R, typename V>
+const bmashina::Local<R>& bmashina::BasicTree<M>::constant_as(const Property<V>& value)
+{
+	auto reference = BasicAllocator::template create<Local<R>>(allocator);
+	constants.insert(reference);
+	constant_values.template set_as<V>(*reference, value);
+
+	return *reference;
+}
+
+template <typename M>
+bool bmashina::BasicTree<M>::is_constant(const detail::BaseReference& reference) const
+{
+	return constants.count(const_cast<detail::BaseReference*>(&reference)) != 0;
+}
+
+template <typename M>
+const typename bmashina::BasicTree<M>::State&
+bmashina::BasicTree<M>::get_constants() const
+{
+	return constant_values;
+}
+
 template <typename M>
 void bmashina::BasicTree<M>::input(const detail::BaseReference& reference)
 {
 	inputs.insert(&reference);
 }
 
+template <typename M>
+const bmashina::detail::BaseReference& bmashina::BasicTree<M>::get_input_source(
+	const Node& node,
+	const detail::BaseReference& to) const
+{
+	WireIterator begin, end;
+	get_wires(node, node_inputs, compiled_input_spans, compiled_inputs, begin, end);
+	for (auto i = begin; i != end; ++i)
+	{
+		if (std::get<1>(*i)->slot == to.slot)
+		{
+			return *std::get<0>(*i);
+		}
+	}
+
+	return to;
+}
+
 template <typename M>
 void bmashina::BasicTree<M>::output(const detail::BaseReference& reference)
 {
@@ -661,6 +941,7 @@ void bmashina::BasicTree<M>::input(
 	}
 
 	iter->second.push_back(std::make_tuple(&from, &to));
+	is_compiled = false;
 }
 
 template <typename M>
@@ -704,6 +985,7 @@ void bmashina::BasicTree<M>::output(
 	}
 
 	iter->second.push_back(std::make_tuple(&from, &to));
+	is_compiled = false;
 }
 
 template <typename M>
@@ -0,0 +1,220 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TREE_INSTANCE_HPP
+#define BMASHINA_TREE_INSTANCE_HPP
+
+#include <cassert>
+#include "bmashina/channel.hpp"
+#include "bmashina/config.hpp"
+#include "bmashina/status.hpp"
+#include "bmashina/state/property.hpp"
+#include "bmashina/state/reference.hpp"
+#include "bmashina/state/state.hpp"
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+#include <stdexcept>
+#endif
+
+namespace bmashina
+{
+	template <typename M>
+	class BasicTree;
+
+	template <typename M>
+	class BasicExecutor;
+
+	// A lightweight view of a shared tree. The tree acts as an immutable
+	// template: nodes, children, wires and constants belong to it, and it
+	// should not be modified while instances of it exist. Each instance only
+	// keeps an overlay of channel assignments and constant values, which take
+	// precedence over those of the template while the instance executes.
+	//
+	// The overlay is reached through the executor, so only the template's
+	// own nodes see it; trees assigned to channels execute as usual. Constant
+	// values not overridden read through to the template's. An instance
+	// without constant overrides reads the template's constants directly;
+	// its overlay state is created by the first call to constant.
+	template <typename M>
+	class BasicTreeInstance
+	{
+	public:
+		typedef M Mashina;
+		typedef BasicTree<Mashina> Tree;
+		typedef BasicExecutor<Mashina> Executor;
+		typedef BasicState<Mashina> State;
+		typedef typename BasicChannel<Mashina>::Type Channel;
+		typedef BasicTreeInstance<Mashina> Instance;
+
+		BasicTreeInstance(Mashina& mashina, Tree& tree);
+		BasicTreeInstance(const Instance& other) = delete;
+		~BasicTreeInstance();
+
+		Tree& get_template() const;
+
+		void assign(const Channel& channel, Tree& tree);
+		bool assigned(const Channel& channel) const;
+		void unassign(const Channel& channel);
+
+		// Returns the tree assigned to channel by this instance, or null if
+		// the template's assignment applies.
+		Tree* get_assignment(const Channel& channel) const;
+
+		// Overrides the value of a constant created by the template.
+		template <typename V>
+		void constant(const Local<V>& constant, const Property<V>& value);
+		void reset(const detail::BaseReference& constant);
+		const State& get_constants() const;
+
+		Status execute(Executor& executor);
+
+		Instance& operator =(const Instance& other) = delete;
+
+	private:
+		Mashina* mashina;
+		Tree* tree;
+
+		typedef typename Allocator<Mashina>::Type AllocatorType;
+		AllocatorType allocator;
+
+		typedef UnorderedMap<Mashina, Channel, Tree*> ChannelAssignments;
+		typename ChannelAssignments::Type channel_assignments;
+
+		State* constant_values = nullptr;
+	};
+}
+
+template <typename M>
+bmashina::BasicTreeInstance<M>::BasicTreeInstance(Mashina& mashina, Tree& tree) :
+	mashina(&mashina),
+	tree(&tree),
+	allocator(mashina),
+	channel_assignments(ChannelAssignments::construct(mashina))
+{
+	// Nothing.
+}
+
+template <typename M>
+bmashina::BasicTreeInstance<M>::~BasicTreeInstance()
+{
+	if (constant_values != nullptr)
+	{
+		BasicAllocator::destroy<State>(allocator, constant_values);
+	}
+}
+
+template <typename M>
+typename bmashina::BasicTreeInstance<M>::Tree&
+bmashina::BasicTreeInstance<M>::get_template() const
+{
+	return *tree;
+}
+
+template <typename M>
+void bmashina::BasicTreeInstance<M>::assign(const Channel& channel, Tree& other)
+{
+	assert(tree->has(channel));
+	assert(tree->compatible(other));
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (!tree->has(channel))
+	{
+		throw std::runtime_error("channel does not exist");
+	}
+
+	if (!tree->compatible(other))
+	{
+		throw std::runtime_error("assigning incompatible tree to channel");
+	}
+#endif
+
+	channel_assignments[channel] = &other;
+}
+
+template <typename M>
+bool bmashina::BasicTreeInstance<M>::assigned(const Channel& channel) const
+{
+	return channel_assignments.count(channel) != 0;
+}
+
+template <typename M>
+void bmashina::BasicTreeInstance<M>::unassign(const Channel& channel)
+{
+	channel_assignments.erase(channel);
+}
+
+template <typename M>
+typename bmashina::BasicTreeInstance<M>::Tree*
+bmashina::BasicTreeInstance<M>::get_assignment(const Channel& channel) const
+{
+	if (channel_assignments.empty())
+	{
+		return nullptr;
+	}
+
+	auto iter = channel_assignments.find(channel);
+	if (iter == channel_assignments.end())
+	{
+		return nullptr;
+	}
+
+	return iter->second;
+}
+
+template <typename M>
+template <typename V>
+void bmashina::BasicTreeInstance<M>::constant(
+	const Local<V>& constant,
+	const Property<V>& value)
+{
+	assert(tree->is_constant(constant));
+
+#ifndef BMASHINA_DISABLE_EXCEPTION_HANDLING
+	if (!tree->is_constant(constant))
+	{
+		throw std::runtime_error("reference is not a constant of the template");
+	}
+#endif
+
+	if (constant_values == nullptr)
+	{
+		constant_values = BasicAllocator::create<State>(allocator, *mashina);
+		constant_values->set_fallback(&tree->get_constants());
+	}
+
+	constant_values->set(constant, value);
+}
+
+template <typename M>
+void bmashina::BasicTreeInstance<M>::reset(const detail::BaseReference& constant)
+{
+	if (constant_values != nullptr)
+	{
+		constant_values->unset(constant);
+	}
+}
+
+template <typename M>
+const typename bmashina::BasicTreeInstance<M>::State&
+bmashina::BasicTreeInstance<M>::get_constants() const
+{
+	if (constant_values == nullptr)
+	{
+		return tree->get_constants();
+	}
+
+	return *constant_values;
+}
+
+template <typename M>
+bmashina::Status bmashina::BasicTreeInstance<M>::execute(Executor& executor)
+{
+	return tree->execute(executor, *this);
+}
+
+#endif
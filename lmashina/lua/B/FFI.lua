@@ -0,0 +1,95 @@
+--------------------------------------------------------------------------------
+-- B/FFI.lua
+--
+-- This file is a part of BMASHINA.
+--
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at http://mozilla.org/MPL/2.0/.
+--------------------------------------------------------------------------------
+-- LuaJIT only. Reads and writes numbers, booleans and strings in a state
+-- without going through the State metatable:
+--
+--   local FFI = require "B.FFI"
+--   local s, r = FFI.state(state), FFI.reference(self.TARGET)
+--   FFI.set_number(s, r, (FFI.get_number(s, r) or 0) + 1)
+--
+-- Pointers from FFI.state and FFI.reference are only valid as long as the
+-- state and reference they came from are alive.
+--------------------------------------------------------------------------------
+local B = require "B"
+local ffi = require "ffi"
+
+ffi.cdef [[
+	int bmashina_state_has(void* state, const void* reference);
+	void bmashina_state_unset(void* state, const void* reference);
+	int bmashina_state_get_number(void* state, const void* reference, double* result);
+	void bmashina_state_set_number(void* state, const void* reference, double value);
+	int bmashina_state_get_boolean(void* state, const void* reference, int* result);
+	void bmashina_state_set_boolean(void* state, const void* reference, int value);
+	const char* bmashina_state_get_string(void* state, const void* reference, size_t* length);
+	void bmashina_state_set_string(void* state, const void* reference, const char* value, size_t length);
+]]
+
+local C = ffi.load(package.searchpath("bmashina", package.cpath))
+
+local number = ffi.new("double[1]")
+local boolean = ffi.new("int[1]")
+local length = ffi.new("size_t[1]")
+
+local FFI = {}
+
+function FFI.state(state)
+	return ffi.cast("void*", B.get_state_pointer(state))
+end
+
+function FFI.reference(reference)
+	return ffi.cast("const void*", B.get_reference_pointer(reference))
+end
+
+function FFI.has(state, reference)
+	return C.bmashina_state_has(state, reference) ~= 0
+end
+
+function FFI.unset(state, reference)
+	C.bmashina_state_unset(state, reference)
+end
+
+function FFI.get_number(state, reference)
+	if C.bmashina_state_get_number(state, reference, number) ~= 0 then
+		return number[0]
+	end
+
+	return nil
+end
+
+function FFI.set_number(state, reference, value)
+	C.bmashina_state_set_number(state, reference, value)
+end
+
+function FFI.get_boolean(state, reference)
+	if C.bmashina_state_get_boolean(state, reference, boolean) ~= 0 then
+		return boolean[0] ~= 0
+	end
+
+	return nil
+end
+
+function FFI.set_boolean(state, reference, value)
+	C.bmashina_state_set_boolean(state, reference, value and 1 or 0)
+end
+
+function FFI.get_string(state, reference)
+	local result = C.bmashina_state_get_string(state, reference, length)
+	if result ~= nil then
+		return ffi.string(result, length[0])
+	end
+
+	return nil
+end
+
+function FFI.set_string(state, reference, value)
+	C.bmashina_state_set_string(state, reference, value, #value)
+end
+
+return FFI
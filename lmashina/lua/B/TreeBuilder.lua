@@ -19,7 +19,8 @@ local function import(path, args, aliases)
 		table.insert(real_path, m)
 	end
 
-	local success, result = xpcall(require, debug.traceback, table.concat(real_path, "."))
+	local name = table.concat(real_path, ".")
+	local success, result = xpcall(function() return require(name) end, debug.traceback)
 	if success then
 		return result
 	else
@@ -138,11 +139,12 @@ function TreeBuilder.materialize(mashina, node, aliases)
 
 	local tree = B.Tree(mashina)
 	do
-		local root = node._arguments[1]
-		local class = import(root._path, root._arguments, aliases)
+		local definition = node._arguments[1]
+		local class = import(definition._path, definition._arguments, aliases)
 		local root = tree:child(class)
-		materialize(tree, node, class, root, aliases)
+		materialize(tree, definition, class, root, aliases)
 	end
+	tree:compile()
 
 	return tree
 end
@@ -6,10 +6,15 @@
 //
 // Copyright 2018 [bk]door.maus
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <limits>
+#include <vector>
 
 #include "deps/sol.hpp"
 #include "lmashina/lmashina.hpp"
@@ -26,6 +31,8 @@ using Status = bmashina::Status;
 // Primitives.
 typedef bmashina::Invert<sol::table> Invert;
 typedef bmashina::Failure<sol::table> Failure;
+typedef bmashina::MemorySequence<sol::table> MemorySequence;
+typedef bmashina::MemorySelector<sol::table> MemorySelector;
 typedef bmashina::Sequence<sol::table> Sequence;
 typedef bmashina::Selector<sol::table> Selector;
 typedef bmashina::Success<sol::table> Success;
@@ -77,22 +84,191 @@ namespace bmashina
 	};
 }
 
+// Interns wire names. Each name is stored once, in arena blocks owned by the
+// table, so the returned pointers stay valid for the lifetime of the table
+// and compare equal for equal names. Every name also gets a dense, stable id
+// (stored just before its characters) in the order it was first seen.
 class StringTable
 {
 public:
 	StringTable() = default;
+	StringTable(StringTable&& other) = default;
 	~StringTable() = default;
 
-	const char* get(const std::string& value);
+	const char* get(sol::string_view value);
+
+	// Interns prefix + separator + suffix without building the joined string
+	// first.
+	const char* get(sol::string_view prefix, sol::string_view separator, sol::string_view suffix);
+
+	static std::uint32_t id(const char* value);
+	std::size_t size() const;
 
 private:
-	std::unordered_set<std::string> strings;
+	static constexpr std::uint32_t FNV_OFFSET_BASIS = 2166136261u;
+	static constexpr std::uint32_t FNV_PRIME = 16777619u;
+	static constexpr std::size_t BLOCK_SIZE = 16 * 1024;
+
+	static std::uint32_t hash(sol::string_view value, std::uint32_t h = FNV_OFFSET_BASIS);
+
+	struct Entry
+	{
+		std::uint32_t hash = 0;
+		std::uint32_t length = 0;
+		const char* value = nullptr;
+	};
+
+	std::vector<Entry> entries;
+	std::size_t count = 0;
+
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* block_current = nullptr;
+	char* block_end = nullptr;
+
+	const char* find_or_insert(
+		std::uint32_t h,
+		sol::string_view a,
+		sol::string_view b = sol::string_view(),
+		sol::string_view c = sol::string_view());
+	char* allocate(std::size_t size);
+	void grow();
 };
 
-const char* StringTable::get(const std::string& value)
+std::uint32_t StringTable::hash(sol::string_view value, std::uint32_t h)
+{
+	for (auto c: value)
+	{
+		h ^= (unsigned char)c;
+		h *= FNV_PRIME;
+	}
+
+	return h;
+}
+
+const char* StringTable::get(sol::string_view value)
+{
+	return find_or_insert(hash(value), value);
+}
+
+const char* StringTable::get(sol::string_view prefix, sol::string_view separator, sol::string_view suffix)
+{
+	auto h = hash(suffix, hash(separator, hash(prefix)));
+	return find_or_insert(h, prefix, separator, suffix);
+}
+
+std::uint32_t StringTable::id(const char* value)
+{
+	std::uint32_t result;
+	std::memcpy(&result, value - sizeof(std::uint32_t), sizeof(std::uint32_t));
+
+	return result;
+}
+
+std::size_t StringTable::size() const
+{
+	return count;
+}
+
+const char* StringTable::find_or_insert(
+	std::uint32_t h,
+	sol::string_view a,
+	sol::string_view b,
+	sol::string_view c)
+{
+	if ((count + 1) * 2 > entries.size())
+	{
+		grow();
+	}
+
+	const sol::string_view parts[] = { a, b, c };
+	auto length = a.size() + b.size() + c.size();
+
+	auto mask = entries.size() - 1;
+	for (auto i = h & mask; ; i = (i + 1) & mask)
+	{
+		auto& entry = entries[i];
+		if (entry.value == nullptr)
+		{
+			auto value = allocate(sizeof(std::uint32_t) + length + 1);
+			auto id = (std::uint32_t)count;
+			std::memcpy(value, &id, sizeof(std::uint32_t));
+			value += sizeof(std::uint32_t);
+
+			auto current = value;
+			for (auto& part: parts)
+			{
+				current = std::copy(part.begin(), part.end(), current);
+			}
+			*current = '\0';
+
+			entry.hash = h;
+			entry.length = (std::uint32_t)length;
+			entry.value = value;
+			++count;
+
+			return value;
+		}
+
+		if (entry.hash == h && entry.length == length)
+		{
+			auto current = entry.value;
+			bool equal = true;
+			for (auto& part: parts)
+			{
+				if (!std::equal(part.begin(), part.end(), current))
+				{
+					equal = false;
+					break;
+				}
+
+				current += part.size();
+			}
+
+			if (equal)
+			{
+				return entry.value;
+			}
+		}
+	}
+}
+
+char* StringTable::allocate(std::size_t size)
 {
-	this->strings.emplace(value);
-	return this->strings.find(value)->c_str();
+	if (block_current == nullptr || (std::size_t)(block_end - block_current) < size)
+	{
+		auto block_size = std::max(size, BLOCK_SIZE);
+		blocks.emplace_back(new char[block_size]);
+		block_current = blocks.back().get();
+		block_end = block_current + block_size;
+	}
+
+	auto result = block_current;
+	block_current += size;
+
+	return result;
+}
+
+void StringTable::grow()
+{
+	std::vector<Entry> previous(std::max<std::size_t>(entries.size() * 2, 64));
+	std::swap(entries, previous);
+
+	auto mask = entries.size() - 1;
+	for (auto& entry: previous)
+	{
+		if (entry.value == nullptr)
+		{
+			continue;
+		}
+
+		auto i = entry.hash & mask;
+		while (entries[i].value != nullptr)
+		{
+			i = (i + 1) & mask;
+		}
+
+		entries[i] = entry;
+	}
 }
 
 static StringTable* get_string_table(lua_State* L)
@@ -121,7 +297,7 @@ static StringTable* get_string_table(lua_State* L)
 }
 
 typedef Reference<sol::object> LuaReference;
-static std::shared_ptr<LuaReference> create_reference(const std::string& name, sol::this_state S)
+static std::shared_ptr<LuaReference> create_reference(sol::string_view name, sol::this_state S)
 {
 	lua_State* L = S;
 	auto string_table = get_string_table(L);
@@ -170,6 +346,8 @@ public:
 	LuaProxyNode(lua_State* L, int index);
 	~LuaProxyNode();
 
+	void bind();
+
 	Status update(Executor& executor) override;
 
 	static void public_deactivate(LuaProxyNode* node, Executor& executor);
@@ -179,27 +357,33 @@ protected:
 	void deactivated(Executor& executor) override;
 
 private:
-	sol::object call(Executor& executor, const std::string& method);
-	void event(Executor& executor, const std::string& method);
+	int get_method(const char* method);
+	bool call(Executor& executor, int method, int num_results);
 
 	lua_State* L;
 	sol::table instance;
 	std::map<std::string, LuaLocal> locals;
+
+	// Registry references to the instance's methods, or LUA_NOREF.
+	int update_method = LUA_NOREF;
+	int activated_method = LUA_NOREF;
+	int deactivated_method = LUA_NOREF;
+	int removed_method = LUA_NOREF;
 };
 
 LuaProxyNode::LuaProxyNode(lua_State* L, int index) :
 	L(L), instance(L, sol::create)
 {
 	sol::table definition(L, index);
-	std::string name = definition["name"];
+	auto name = definition.get<sol::string_view>("name");
 
 	for (auto& i: definition)
 	{
 		if (i.second.is<LuaLocalProxy>())
 		{
 			auto string_table = get_string_table(L);
-			std::string local_name = name + "::" + i.first.as<std::string>();
-			instance[i.first] = std::make_shared<LuaLocal>(string_table->get(local_name));
+			auto key = i.first.as<sol::string_view>();
+			instance[i.first] = std::make_shared<LuaLocal>(string_table->get(name, "::", key));
 		}
 		else
 		{
@@ -218,105 +402,111 @@ LuaProxyNode::LuaProxyNode(lua_State* L, int index) :
 	{
 		instance["new"](instance);
 	}
+
+	update_method = get_method("update");
+	activated_method = get_method("activated");
+	deactivated_method = get_method("deactivated");
+	removed_method = get_method("removed");
 }
 
 LuaProxyNode::~LuaProxyNode()
 {
-	instance["tree"] = &tree();
-
-	if (instance["removed"] != sol::nil)
+	if (removed_method != LUA_NOREF)
 	{
-		sol::protected_function m = instance["removed"];
-		auto result = m(instance);
-		if (!result.valid())
+		lua_rawgeti(L, LUA_REGISTRYINDEX, removed_method);
+		instance.push();
+		if (lua_pcall(L, 1, 0, 0) != 0)
 		{
-			sol::error e = result;
-
-			auto L = instance.lua_state();
-			lua_pushstring(L, e.what());
 			lua_error(L);
 		}
 	}
+
+	luaL_unref(L, LUA_REGISTRYINDEX, update_method);
+	luaL_unref(L, LUA_REGISTRYINDEX, activated_method);
+	luaL_unref(L, LUA_REGISTRYINDEX, deactivated_method);
+	luaL_unref(L, LUA_REGISTRYINDEX, removed_method);
+}
+
+void LuaProxyNode::bind()
+{
+	instance["tree"] = &tree();
 }
 
 Status
 LuaProxyNode::update(Executor& executor)
 {
-	auto result = call(executor, "update");
-	if (result == sol::nil || !result.is<int>())
+	if (!call(executor, update_method, 1))
 	{
 		return Status::failure;
 	}
-	else
+
+	auto result = Status::failure;
+	if (lua_type(L, -1) == LUA_TNUMBER)
 	{
-		auto value = (Status)result.as<int>();
+		auto value = (Status)lua_tointeger(L, -1);
 		switch (value)
 		{
 			case Status::working:
 			case Status::success:
 			case Status::failure:
-				return value;
+				result = value;
+				break;
 			default:
-				return Status::failure;
+				break;
 		}
 	}
+	lua_pop(L, 1);
+
+	return result;
 }
 
 void LuaProxyNode::activated(Executor& executor)
 {
-	event(executor, "activated");
+	call(executor, activated_method, 0);
 }
 
 void LuaProxyNode::deactivated(Executor& executor)
 {
-	event(executor, "deactivated");
+	call(executor, deactivated_method, 0);
 }
 
-sol::object LuaProxyNode::call(
-	Executor& executor,
-	const std::string& method)
+int LuaProxyNode::get_method(const char* method)
 {
-	instance["tree"] = &tree();
+	instance.push();
+	lua_getfield(L, -1, method);
+	lua_remove(L, -2);
 
-	if (instance[method] != sol::nil)
+	if (lua_isnil(L, -1))
 	{
-		sol::protected_function m = instance[method];
-		auto result = m(instance, executor.mashina(), &executor.state(), &executor);
-		if (!result.valid())
-		{
-			sol::error e = result;
-
-			auto L = instance.lua_state();
-			lua_pushstring(L, e.what());
-			lua_error(L);
-		}
-
-		return result;
+		lua_pop(L, 1);
+		return LUA_NOREF;
 	}
 
-	return sol::make_object(L, (int)Status::failure);
+	return luaL_ref(L, LUA_REGISTRYINDEX);
 }
 
-void LuaProxyNode::event(
+bool LuaProxyNode::call(
 	Executor& executor,
-	const std::string& method)
+	int method,
+	int num_results)
 {
-	instance["tree"] = &tree();
-
-	if (instance[method] != sol::nil)
+	if (method == LUA_NOREF)
 	{
-		sol::protected_function m = instance[method];
-		auto result = m(instance, executor.mashina(), &executor.state(), &executor);
+		return false;
+	}
 
-		if (!result.valid())
-		{
-			sol::error e = result;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, method);
+	instance.push();
+	executor.mashina().push();
+	sol::stack::push(L, &executor.state());
+	sol::stack::push(L, &executor);
 
-			auto L = instance.lua_state();
-			lua_pushstring(L, e.what());
-			lua_error(L);
-		}
+	if (lua_pcall(L, 4, num_results, 0) != 0)
+	{
+		lua_error(L);
 	}
+
+	return true;
 }
 
 std::shared_ptr<Tree> tree_create(sol::table mashina, sol::this_state S)
@@ -327,7 +517,8 @@ std::shared_ptr<Tree> tree_create(sol::table mashina, sol::this_state S)
 
 decltype(auto) tree_children(
 	Tree* tree,
-	Node* parent)
+	Node* parent,
+	sol::this_state S)
 {
 	std::vector<Node*> children;
 	for (auto i = tree->children_begin(*parent); i != tree->children_end(*parent); ++i)
@@ -336,6 +527,11 @@ decltype(auto) tree_children(
 		children.push_back(&node);
 	}
 
+	// Every child is returned on the stack, which only has LUA_MINSTACK
+	// free slots.
+	lua_State* L = S;
+	luaL_checkstack(L, (int)children.size(), "too many children");
+
 	return sol::as_returns(std::move(children));
 }
 
@@ -343,10 +539,30 @@ LuaLocal* tree_constant(Tree* tree, sol::this_state S)
 {
 	lua_State* L = S;
 	sol::object object(L, 2);
-	return const_cast<LuaLocal*>(&tree->constant<sol::object>(object));
+
+	// Stored like state_newindex values so the FFI functions can read
+	// constants too.
+	const LuaLocal* result;
+	switch (object.get_type())
+	{
+		case sol::type::number:
+			result = &tree->constant_as<sol::object, double>(object.as<double>());
+			break;
+		case sol::type::boolean:
+			result = &tree->constant_as<sol::object, bool>(object.as<bool>());
+			break;
+		case sol::type::string:
+			result = &tree->constant_as<sol::object, std::string>(object.as<std::string>());
+			break;
+		default:
+			result = &tree->constant<sol::object>(object);
+			break;
+	}
+
+	return const_cast<LuaLocal*>(result);
 }
 
-LuaLocal* tree_local(Tree* tree, const std::string& key, sol::this_state S)
+LuaLocal* tree_local(Tree* tree, sol::string_view key, sol::this_state S)
 {
 	lua_State* L = S;
 	auto table = get_string_table(L);
@@ -356,7 +572,7 @@ LuaLocal* tree_local(Tree* tree, const std::string& key, sol::this_state S)
 sol::object tree_child(Tree* tree, sol::object p, sol::this_state S)
 {
 	lua_State* L = S;
-	Node* node;
+	LuaProxyNode* node;
 	if (tree->empty())
 	{
 		node = &tree->root<LuaProxyNode>(L, 2);
@@ -371,6 +587,7 @@ sol::object tree_child(Tree* tree, sol::object p, sol::this_state S)
 
 		node = &tree->child<LuaProxyNode>(*parent, L, 3);
 	}
+	node->bind();
 
 	return sol::make_object<Node*>(L, node);
 }
@@ -385,6 +602,11 @@ bool tree_empty(Tree* tree)
 	return tree->empty();
 }
 
+void tree_compile(Tree* tree)
+{
+	tree->compile();
+}
+
 static const bmashina::detail::BaseReference* to_reference(sol::object o)
 {
 	if (o.is<LuaLocal*>())
@@ -399,6 +621,18 @@ static const bmashina::detail::BaseReference* to_reference(sol::object o)
 	return nullptr;
 }
 
+static sol::object get_wire_id(sol::object r, sol::this_state S)
+{
+	lua_State* L = S;
+	const bmashina::detail::BaseReference* reference = to_reference(r);
+	if (reference == nullptr || reference->name == nullptr)
+	{
+		return sol::nil;
+	}
+
+	return sol::make_object(L, (double)StringTable::id(reference->name));
+}
+
 static bool tree_input(
 	Tree* tree,
 	Node* node,
@@ -454,6 +688,77 @@ static int tree_execute(
 	return (int)tree->execute(*executor);
 }
 
+static Tree* to_tree(lua_State* L, int index)
+{
+	auto tree = sol::stack::check_get<Tree*>(L, index);
+	if (!tree || *tree == nullptr)
+	{
+		luaL_error(L, "expected Tree at argument %d", index);
+		return nullptr;
+	}
+
+	if (!(*tree)->compiled())
+	{
+		(*tree)->compile();
+	}
+
+	return *tree;
+}
+
+// execute(executors, tree_or_trees, results) ticks executors[i] against
+// either a single tree or trees[i], storing each status in results[i]. The
+// results table is created if not provided, and is returned.
+static int execute_all(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_settop(L, 3);
+
+	auto count = (int)lua_objlen(L, 1);
+	bool single_tree = !lua_istable(L, 2);
+
+	Tree* tree = nullptr;
+	if (single_tree)
+	{
+		tree = to_tree(L, 2);
+	}
+
+	if (lua_isnil(L, 3))
+	{
+		lua_createtable(L, count, 0);
+		lua_replace(L, 3);
+	}
+	else
+	{
+		luaL_checktype(L, 3, LUA_TTABLE);
+	}
+
+	for (int i = 1; i <= count; ++i)
+	{
+		lua_rawgeti(L, 1, i);
+		auto executor = sol::stack::check_get<Executor*>(L, -1);
+		if (!executor || *executor == nullptr)
+		{
+			return luaL_error(L, "expected Executor at index %d", i);
+		}
+		lua_pop(L, 1);
+
+		if (!single_tree)
+		{
+			lua_rawgeti(L, 2, i);
+			tree = to_tree(L, -1);
+			lua_pop(L, 1);
+		}
+
+		auto status = tree->execute(**executor);
+
+		lua_pushinteger(L, (int)status);
+		lua_rawseti(L, 3, i);
+	}
+
+	lua_pushvalue(L, 3);
+	return 1;
+}
+
 std::shared_ptr<Executor> executor_create(sol::table mashina, sol::this_state S)
 {
 	lua_State* L = S;
@@ -479,6 +784,33 @@ static int executor_update(
 	return (int)executor->update(*node);
 }
 
+static bool executor_watch(
+	Executor* executor,
+	sol::object r)
+{
+	const bmashina::detail::BaseReference* reference = to_reference(r);
+	if (reference == nullptr)
+	{
+		return false;
+	}
+
+	executor->watch(*reference);
+
+	return true;
+}
+
+static void executor_set_event_driven(
+	Executor* executor,
+	bool value)
+{
+	executor->set_event_driven(value);
+}
+
+static bool executor_get_event_driven(Executor* executor)
+{
+	return executor->get_event_driven();
+}
+
 static State* executor_state(
 	Executor* executor)
 {
@@ -491,31 +823,35 @@ std::shared_ptr<State> state_create(sol::table mashina, sol::this_state S)
 	return std::make_shared<State>(mashina);
 }
 
+// Numbers, booleans and strings are stored natively so the FFI functions
+// below can read and write them without touching the Lua stack. Any other
+// value is kept as a sol::object.
 sol::object state_index(State* state, sol::object key, sol::this_state S)
 {
 	lua_State* L = S;
-	if (key.is<LuaLocal*>())
+	const bmashina::detail::BaseReference* reference = to_reference(key);
+	if (reference == nullptr)
 	{
-		auto reference = key.as<LuaLocal*>();
-		if (state->has(*reference))
-		{
-			auto value = state->get(*reference);
-			if (value.lua_state() == L)
-			{
-				return value;
-			}
-		}
+		return sol::nil;
+	}
+
+	if (auto number = state->get_as<double>(*reference))
+	{
+		return sol::make_object(L, *number);
+	}
+	else if (auto boolean = state->get_as<bool>(*reference))
+	{
+		return sol::make_object(L, *boolean);
 	}
-	else if (key.is<LuaReference*>())
+	else if (auto string = state->get_as<std::string>(*reference))
 	{
-		auto reference = key.as<LuaReference*>();
-		if (state->has(*reference))
+		return sol::make_object(L, *string);
+	}
+	else if (auto object = state->get_as<sol::object>(*reference))
+	{
+		if (object->lua_state() == L)
 		{
-			auto value = state->get(*reference);
-			if (value.lua_state() == L)
-			{
-				return value;
-			}
+			return *object;
 		}
 	}
 
@@ -524,32 +860,133 @@ sol::object state_index(State* state, sol::object key, sol::this_state S)
 
 void state_newindex(State* state, sol::object key, sol::object value, sol::this_state S)
 {
-	if (key.is<LuaLocal*>())
+	const bmashina::detail::BaseReference* reference = to_reference(key);
+	if (reference == nullptr)
 	{
-		auto reference = key.as<LuaLocal*>();
-		if (value == sol::nil)
-		{
-			state->unset(*reference);
-		}
-		else
-		{
-			state->set(*reference, value);
-		}
+		return;
 	}
-	else if (key.is<LuaReference*>())
+
+	switch (value.get_type())
 	{
-		auto reference = key.as<LuaReference*>();
-		if (value == sol::nil)
-		{
+		case sol::type::nil:
+		case sol::type::none:
 			state->unset(*reference);
-		}
-		else
-		{
-			state->set(*reference, value);
-		}
+			break;
+		case sol::type::number:
+			state->set_as<double>(*reference, value.as<double>());
+			break;
+		case sol::type::boolean:
+			state->set_as<bool>(*reference, value.as<bool>());
+			break;
+		case sol::type::string:
+			state->set_as<std::string>(*reference, value.as<std::string>());
+			break;
+		default:
+			state->set_as<sol::object>(*reference, value);
+			break;
 	}
 }
 
+static sol::object get_state_pointer(State* state, sol::this_state S)
+{
+	lua_State* L = S;
+	return sol::make_object(L, sol::lightuserdata_value(state));
+}
+
+static sol::object get_reference_pointer(sol::object r, sol::this_state S)
+{
+	lua_State* L = S;
+	const bmashina::detail::BaseReference* reference = to_reference(r);
+	if (reference == nullptr)
+	{
+		return sol::nil;
+	}
+
+	return sol::make_object(L, sol::lightuserdata_value(const_cast<bmashina::detail::BaseReference*>(reference)));
+}
+
+// C API for LuaJIT's FFI (see B/FFI.lua). 'state' and 'reference' are the
+// pointers returned by B.get_state_pointer and B.get_reference_pointer. These
+// never call into Lua, as FFI callees must not.
+static State* ffi_state(void* state)
+{
+	return static_cast<State*>(state);
+}
+
+static const bmashina::detail::BaseReference* ffi_reference(const void* reference)
+{
+	return static_cast<const bmashina::detail::BaseReference*>(reference);
+}
+
+extern "C"
+BMASHINA_EXPORT int bmashina_state_has(void* state, const void* reference)
+{
+	return ffi_state(state)->has(*ffi_reference(reference));
+}
+
+extern "C"
+BMASHINA_EXPORT void bmashina_state_unset(void* state, const void* reference)
+{
+	ffi_state(state)->unset(*ffi_reference(reference));
+}
+
+extern "C"
+BMASHINA_EXPORT int bmashina_state_get_number(void* state, const void* reference, double* result)
+{
+	auto value = ffi_state(state)->get_as<double>(*ffi_reference(reference));
+	if (value == nullptr)
+	{
+		return 0;
+	}
+
+	*result = *value;
+	return 1;
+}
+
+extern "C"
+BMASHINA_EXPORT void bmashina_state_set_number(void* state, const void* reference, double value)
+{
+	ffi_state(state)->set_as<double>(*ffi_reference(reference), value);
+}
+
+extern "C"
+BMASHINA_EXPORT int bmashina_state_get_boolean(void* state, const void* reference, int* result)
+{
+	auto value = ffi_state(state)->get_as<bool>(*ffi_reference(reference));
+	if (value == nullptr)
+	{
+		return 0;
+	}
+
+	*result = *value ? 1 : 0;
+	return 1;
+}
+
+extern "C"
+BMASHINA_EXPORT void bmashina_state_set_boolean(void* state, const void* reference, int value)
+{
+	ffi_state(state)->set_as<bool>(*ffi_reference(reference), value != 0);
+}
+
+extern "C"
+BMASHINA_EXPORT const char* bmashina_state_get_string(void* state, const void* reference, size_t* length)
+{
+	auto value = ffi_state(state)->get_as<std::string>(*ffi_reference(reference));
+	if (value == nullptr)
+	{
+		return nullptr;
+	}
+
+	*length = value->size();
+	return value->c_str();
+}
+
+extern "C"
+BMASHINA_EXPORT void bmashina_state_set_string(void* state, const void* reference, const char* value, size_t length)
+{
+	ffi_state(state)->set_as<std::string>(*ffi_reference(reference), std::string(value, length));
+}
+
 extern "C"
 BMASHINA_EXPORT int luaopen_bmashina(lua_State* L)
 {
@@ -559,6 +996,10 @@ BMASHINA_EXPORT int luaopen_bmashina(lua_State* L)
 	result["Local"] = create_local;
 	result["is_local"] = is_local;
 	result["get_wire_name"] = get_name;
+	result["get_wire_id"] = get_wire_id;
+	result["execute"] = &execute_all;
+	result["get_state_pointer"] = get_state_pointer;
+	result["get_reference_pointer"] = get_reference_pointer;
 	result["Status"] = sol::table(L, sol::create);
 	result["Status"]["Success"] = (int)Status::success;
 	result["Status"]["Failure"] = (int)Status::failure;
@@ -573,6 +1014,7 @@ BMASHINA_EXPORT int luaopen_bmashina(lua_State* L)
 		"child", &tree_child,
 		"root", &tree_root,
 		"empty", &tree_empty,
+		"compile", &tree_compile,
 		"input", &tree_input,
 		"output", &tree_output,
 		"execute", &tree_execute);
@@ -583,6 +1025,9 @@ BMASHINA_EXPORT int luaopen_bmashina(lua_State* L)
 		"visit", &executor_visit,
 		"drop", &executor_drop,
 		"update", &executor_update,
+		"watch", &executor_watch,
+		"set_event_driven", &executor_set_event_driven,
+		"get_event_driven", &executor_get_event_driven,
 		"state", &executor_state);
 
 	result.new_usertype<State>(
@@ -64,3 +64,196 @@ solution "BMASHINA"
 		}
 
 		links { "lua51" }
+
+	project "benchmark"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/benchmark/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/benchmark/release"
+			targetdir "bin"
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "benchmark"
+
+		files {
+			"bmashina/include/**.hpp",
+			"benchmark/common/**.cpp",
+			"benchmark/common/**.hpp",
+			"benchmark/native/**.cpp",
+			"benchmark/native/**.hpp"
+		}
+
+		includedirs {
+			"bmashina/include",
+			"benchmark/common"
+		}
+
+	project "benchmark_lua"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/benchmark_lua/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/benchmark_lua/release"
+			targetdir "bin"
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "benchmark"
+
+		files {
+			"benchmark/common/**.cpp",
+			"benchmark/common/**.hpp",
+			"benchmark/lua/**.cpp",
+			"benchmark/lua/**.lua"
+		}
+
+		includedirs {
+			path.join(_OPTIONS["deps"] or _DEFAULTS["deps"], "include"),
+			"benchmark/common"
+		}
+
+		libdirs {
+			path.join(_OPTIONS["deps"] or _DEFAULTS["deps"], "lib")
+		}
+
+		links { "bmashina", "lua51" }
+
+	project "trace2json"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/trace2json/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/trace2json/release"
+			targetdir "bin"
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "tools"
+
+		files {
+			"bmashina/include/**.hpp",
+			"tools/trace2json/**.cpp"
+		}
+
+		includedirs {
+			"bmashina/include"
+		}
+
+	project "test_allocations"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/test_allocations/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/test_allocations/release"
+			targetdir "bin"
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "test"
+
+		files {
+			"bmashina/include/**.hpp",
+			"benchmark/common/**.cpp",
+			"benchmark/common/**.hpp",
+			"test/allocations/**.cpp"
+		}
+
+		includedirs {
+			"bmashina/include",
+			"benchmark/common"
+		}
+
+	project "test_parallel"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/test_parallel/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/test_parallel/release"
+			targetdir "bin"
+		configuration "linux"
+			links { "pthread" }
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "test"
+
+		files {
+			"bmashina/include/**.hpp",
+			"test/parallel/**.cpp"
+		}
+
+		includedirs {
+			"bmashina/include"
+		}
+
+	project "test_unit"
+		language "C++"
+		kind "ConsoleApp"
+
+		cppdialect "C++17"
+
+		configuration "Debug"
+			targetsuffix "_debug"
+			objdir "obj/test_unit/debug"
+			targetdir "bin"
+		configuration "Release"
+			objdir "obj/test_unit/release"
+			targetdir "bin"
+		configuration "macosx"
+			systemversion "10.7"
+		configuration {}
+			runtime "release"
+
+		location "test"
+
+		files {
+			"bmashina/include/**.hpp",
+			"test/unit/**.cpp",
+			"test/unit/**.hpp"
+		}
+
+		includedirs {
+			"bmashina/include"
+		}
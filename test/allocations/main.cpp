@@ -0,0 +1,231 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "counters.hpp"
+
+struct Agent
+{
+	bool operator ==(const Agent& other) const
+	{
+		return true;
+	}
+};
+
+#include "bmashina/config.hpp"
+
+static std::size_t allocator_allocations = 0;
+namespace bmashina
+{
+	template <>
+	struct Allocator<Agent>
+	{
+		struct Type : public BasicAllocator
+		{
+			Type(Agent& agent)
+			{
+				// Nothing.
+			}
+
+			void* allocate(std::size_t num_bytes) override
+			{
+				++allocator_allocations;
+				return std::malloc(num_bytes);
+			}
+
+			void deallocate(void* value) override
+			{
+				std::free(value);
+			}
+		};
+	};
+}
+
+#include "bmashina/arenaAllocator.hpp"
+
+namespace bmashina
+{
+	// Keeps track of the executor's scratch arena.
+	template <>
+	struct ScratchAllocator<Agent>
+	{
+		struct Type : public ArenaAllocator<Agent>
+		{
+			static Type* instance;
+
+			Type(Agent& agent) :
+				ArenaAllocator<Agent>(agent)
+			{
+				instance = this;
+			}
+		};
+	};
+
+	ScratchAllocator<Agent>::Type* ScratchAllocator<Agent>::Type::instance = nullptr;
+}
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/builder/builder.hpp"
+#include "bmashina/primitives/primitives.hpp"
+
+typedef bmashina::BasicTree<Agent> Tree;
+typedef bmashina::BasicNode<Agent> Node;
+typedef bmashina::BasicExecutor<Agent> Executor;
+typedef bmashina::Sequence<Agent> Sequence;
+typedef bmashina::Status Status;
+
+static bmashina::Reference<int> COUNT;
+static bmashina::Reference<float> TIME;
+static bmashina::Reference<double> DISTANCE;
+static bmashina::Reference<std::string> NAME;
+static const bmashina::Property<std::string> NAME_VALUE(std::string(64, 'a'));
+
+// Overwrites int and float values every tick, the common case for state
+// written by leaves. The string is longer than any small string buffer, so
+// it lives in a heap-allocated property that must be reused.
+class Counter : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		auto& state = executor.state();
+
+		state.set(COUNT, state.get(COUNT, 0) + 1);
+		state.set(TIME, state.get(TIME, 0.0f) + 0.5f);
+		state.set(DISTANCE, state.get(DISTANCE, 0.0) * 0.5 + 1.0);
+		state.set(NAME, NAME_VALUE);
+
+		return Status::success;
+	}
+};
+
+static bmashina::Reference<std::string> TEXT;
+static bmashina::Reference<std::string> FORWARDED;
+
+// Does nothing; its input is wired straight back out. Wired inputs are
+// copied into the executor's scratch arena, which must be empty again
+// after every tick.
+class Forward : public Node
+{
+public:
+	static bmashina::Reference<std::string> INPUT;
+};
+
+bmashina::Reference<std::string> Forward::INPUT;
+
+static const std::size_t WARMUP_TICKS = 16;
+static const std::size_t TICKS = 10000;
+
+static bool check_allocations(const char* name, std::size_t allocations, std::size_t heap)
+{
+	if (allocations != 0 || heap != 0)
+	{
+		std::fprintf(
+			stderr,
+			"FAIL: %s: %zu allocator and %zu operator new calls over %zu steady-state ticks\n",
+			name, allocations, heap, TICKS);
+		return false;
+	}
+
+	std::printf("PASS: %s: no allocations over %zu steady-state ticks\n", name, TICKS);
+	return true;
+}
+
+static bool test_set()
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	bmashina::NativeTreeBuilder builder;
+	auto root = builder.begin(tree).child<Sequence>();
+	root.child<Counter>();
+	root.child<Counter>();
+
+	for (std::size_t i = 0; i < WARMUP_TICKS; ++i)
+	{
+		tree.execute(executor);
+	}
+
+	auto allocations_before = allocator_allocations;
+	auto heap_before = benchmark::get_heap_allocations();
+	for (std::size_t i = 0; i < TICKS; ++i)
+	{
+		tree.execute(executor);
+	}
+	auto allocations = allocator_allocations - allocations_before;
+	auto heap = benchmark::get_heap_allocations() - heap_before;
+
+	int expected = (int)(2 * (WARMUP_TICKS + TICKS));
+	int count = executor.state().get(COUNT, 0);
+	if (count != expected)
+	{
+		std::fprintf(stderr, "FAIL: set: count is %d, expected %d\n", count, expected);
+		return false;
+	}
+
+	return check_allocations("set", allocations, heap);
+}
+
+static bool test_forward()
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	auto& root = tree.root<Sequence>();
+	auto& forward = tree.child<Forward>(root);
+	tree.input(forward, TEXT, Forward::INPUT);
+	tree.output(forward, Forward::INPUT, FORWARDED);
+
+	auto& scratch = *bmashina::ScratchAllocator<Agent>::Type::instance;
+	executor.state().set(TEXT, std::string(200, 'a'));
+
+	for (std::size_t i = 0; i < WARMUP_TICKS; ++i)
+	{
+		tree.execute(executor);
+	}
+
+	auto num_blocks = scratch.get_num_blocks();
+	auto allocations_before = allocator_allocations;
+	for (std::size_t i = 0; i < TICKS; ++i)
+	{
+		tree.execute(executor);
+
+		if (scratch.get_num_live() != 0 || scratch.get_num_blocks() != num_blocks)
+		{
+			std::fprintf(
+				stderr,
+				"FAIL: forward: %zu live scratch values and %zu blocks (was %zu) after tick %zu\n",
+				scratch.get_num_live(), scratch.get_num_blocks(), num_blocks, i);
+			return false;
+		}
+	}
+	auto allocations = allocator_allocations - allocations_before;
+
+	if (executor.state().get(FORWARDED, std::string()) != std::string(200, 'a'))
+	{
+		std::fprintf(stderr, "FAIL: forward: value was not forwarded\n");
+		return false;
+	}
+
+	// Copying the string into the wired input allocates its characters
+	// through std::allocator, so only allocator calls are counted.
+	return check_allocations("forward", allocations, 0);
+}
+
+int main(int argc, const char* argv[])
+{
+	bool success = true;
+	success = test_set() && success;
+	success = test_forward() && success;
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct Agent
+{
+	std::size_t id = 0;
+	bool slow = false;
+
+	bool operator ==(const Agent& other) const
+	{
+		return id == other.id;
+	}
+};
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/parallelExecutor.hpp"
+#include "bmashina/primitives/primitives.hpp"
+
+typedef bmashina::BasicTree<Agent> Tree;
+typedef bmashina::BasicNode<Agent> Node;
+typedef bmashina::BasicExecutor<Agent> Executor;
+typedef bmashina::BasicParallelExecutor<Agent> ParallelExecutor;
+typedef bmashina::Sequence<Agent> Sequence;
+typedef bmashina::Selector<Agent> Selector;
+typedef bmashina::Status Status;
+
+static bmashina::Reference<int> TICKS;
+static bmashina::Reference<int> TOTAL;
+static bmashina::Reference<int> LAST;
+static bmashina::Reference<int> WAITED;
+static bmashina::Reference<int> DONE;
+
+// Thread that last ran each agent in the parallel population.
+static std::vector<std::thread::id> threads_by_agent;
+
+// Adds the wired-in constant scaled by the agent and wires the result out.
+class Step : public Node
+{
+public:
+	static bmashina::Reference<int> SCALE;
+	static bmashina::Reference<int> RESULT;
+
+	Status update(Executor& executor) override
+	{
+		auto& state = executor.state();
+
+		state.set(TICKS, state.get(TICKS, 0) + 1);
+
+		int value = state.get(SCALE, 0) * (int)(executor->id % 7 + 1);
+		state.set(TOTAL, state.get(TOTAL, 0) + value);
+		state.set(RESULT, value);
+
+		return Status::success;
+	}
+};
+
+bmashina::Reference<int> Step::SCALE;
+bmashina::Reference<int> Step::RESULT;
+
+class Gate : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		auto ticks = (std::size_t)executor.state().get(TICKS, 0);
+		if ((executor->id + ticks) % 3 == 0)
+		{
+			return Status::failure;
+		}
+
+		return Status::success;
+	}
+};
+
+// Keeps the agent working for a number of ticks that depends on its id.
+class Wait : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		auto& state = executor.state();
+
+		int waited = state.get(WAITED, 0) + 1;
+		state.set(WAITED, waited);
+		if (waited % (int)(executor->id % 4 + 1) != 0)
+		{
+			return Status::working;
+		}
+
+		return Status::success;
+	}
+};
+
+class Record : public Node
+{
+public:
+	Status update(Executor& executor) override
+	{
+		auto& state = executor.state();
+		state.set(DONE, state.get(DONE, 0) + 1);
+
+		if (executor->slow)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+		threads_by_agent[executor->id] = std::this_thread::get_id();
+
+		return Status::success;
+	}
+};
+
+static void build(Tree& tree)
+{
+	auto& scale = tree.constant<int>(bmashina::Property<int>(3));
+
+	auto& root = tree.root<Sequence>();
+	auto& step = tree.child<Step>(root);
+	tree.input(step, scale, Step::SCALE);
+	tree.output(step, Step::RESULT, LAST);
+
+	auto& selector = tree.child<Selector>(root);
+	tree.child<Gate>(selector);
+	tree.child<Wait>(selector);
+
+	tree.child<Record>(root);
+}
+
+typedef std::vector<std::unique_ptr<Executor>> Population;
+
+static void populate(Population& population, std::size_t count, std::size_t num_slow)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		Agent agent;
+		agent.id = i;
+		agent.slow = i < num_slow;
+
+		population.emplace_back(new Executor(agent));
+	}
+}
+
+static bool compare(const Executor& a, const Executor& b, std::size_t id)
+{
+	auto& state_a = const_cast<Executor&>(a).state();
+	auto& state_b = const_cast<Executor&>(b).state();
+
+	bmashina::Reference<int>* references[] = { &TICKS, &TOTAL, &LAST, &WAITED, &DONE };
+	const char* names[] = { "ticks", "total", "last", "waited", "done" };
+	for (std::size_t i = 0; i < sizeof(references) / sizeof(references[0]); ++i)
+	{
+		if (state_a.has(*references[i]) != state_b.has(*references[i]) ||
+			state_a.get(*references[i], -1) != state_b.get(*references[i], -1))
+		{
+			std::fprintf(
+				stderr,
+				"FAIL: agent %zu: %s is %d in parallel, %d serially\n",
+				id, names[i],
+				state_a.get(*references[i], -1), state_b.get(*references[i], -1));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Ticks 'count' agents in parallel and serially against the same tree and
+// compares the results. If 'expect_steal' is set, agents initially given to
+// the calling thread are slowed down until one of them is ticked by another
+// worker.
+static bool test(
+	Tree& tree,
+	ParallelExecutor& parallel_executor,
+	std::size_t count,
+	std::size_t grain,
+	bool expect_steal)
+{
+	static const std::size_t NUM_TICKS = 12;
+
+	auto num_workers = parallel_executor.get_num_threads() + 1;
+	auto num_chunks = (count + grain - 1) / grain;
+	auto num_owned = (num_chunks / num_workers) * grain;
+	if (num_owned > count)
+	{
+		num_owned = count;
+	}
+
+	Population parallel;
+	Population serial;
+	populate(parallel, count, expect_steal ? num_owned : 0);
+	populate(serial, count, 0);
+
+	std::vector<Executor*> executors;
+	for (auto& executor: parallel)
+	{
+		executors.push_back(executor.get());
+	}
+
+	threads_by_agent.assign(count, std::thread::id());
+
+	bool stolen = false;
+	std::vector<Status> parallel_results(count);
+	for (std::size_t tick = 0; tick < NUM_TICKS; ++tick)
+	{
+		parallel_executor.execute(tree, executors.data(), count, parallel_results.data(), grain);
+
+		for (std::size_t i = 0; i < num_owned; ++i)
+		{
+			if (threads_by_agent[i] != std::this_thread::get_id())
+			{
+				stolen = true;
+			}
+		}
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			auto status = tree.execute(*serial[i]);
+			if (status != parallel_results[i])
+			{
+				std::fprintf(
+					stderr,
+					"FAIL: agent %zu returned %d in parallel, %d serially on tick %zu\n",
+					i, (int)parallel_results[i], (int)status, tick);
+				return false;
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (!compare(*parallel[i], *serial[i], i))
+		{
+			return false;
+		}
+	}
+
+	if (expect_steal && !stolen)
+	{
+		std::fprintf(stderr, "FAIL: no work was stolen from the calling thread\n");
+		return false;
+	}
+
+	std::printf(
+		"PASS: %zu agents, grain %zu, %zu workers%s\n",
+		count, grain, num_workers, stolen ? ", stolen" : "");
+	return true;
+}
+
+int main(int argc, const char* argv[])
+{
+	Agent agent;
+	Tree tree(agent);
+	build(tree);
+	tree.compile();
+
+	ParallelExecutor parallel_executor(agent, 3);
+
+	bool success = true;
+
+	// Chunks split unevenly across workers, with a partial last chunk.
+	success = test(tree, parallel_executor, 1000, 7, false) && success;
+
+	// Fewer chunks than workers.
+	success = test(tree, parallel_executor, 5, 2, false) && success;
+
+	// A single chunk, and one agent per chunk.
+	success = test(tree, parallel_executor, 64, 64, false) && success;
+	success = test(tree, parallel_executor, 37, 1, false) && success;
+
+	// The calling thread's agents are slow, so other workers steal them.
+	success = test(tree, parallel_executor, 400, 4, true) && success;
+
+	return success ? 0 : 1;
+}
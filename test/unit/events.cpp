@@ -0,0 +1,125 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/primitives/primitives.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::Sequence<Agent> Sequence;
+	typedef bmashina::Status Status;
+
+	bmashina::Reference<int> SIGNAL;
+	bmashina::Reference<int> CHILD_SIGNAL;
+
+	// Watches its input and works until it is set.
+	class Waiter : public Node
+	{
+	public:
+		static bmashina::Reference<int> INPUT;
+
+		int updates = 0;
+
+		Status update(Executor& executor) override
+		{
+			++updates;
+			executor.watch(INPUT);
+
+			if (executor.state().has(INPUT))
+			{
+				return Status::success;
+			}
+
+			return Status::working;
+		}
+	};
+
+	bmashina::Reference<int> Waiter::INPUT;
+}
+
+TEST_CASE(watch_sleeps_until_reference_changes)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+	executor.set_event_driven(true);
+
+	tree.root<Sequence>();
+	auto& waiter = tree.child<Waiter>(tree.root());
+
+	for (int i = 0; i < 10; ++i)
+	{
+		CHECK(tree.execute(executor) == Status::working);
+	}
+	CHECK(waiter.updates == 1);
+
+	executor.state().set(Waiter::INPUT, 1);
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(waiter.updates == 2);
+}
+
+TEST_CASE(watch_wired_input_sleeps_until_source_changes)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+	executor.set_event_driven(true);
+
+	tree.root<Sequence>();
+	auto& waiter = tree.child<Waiter>(tree.root());
+	tree.input(waiter, SIGNAL, Waiter::INPUT);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		CHECK(tree.execute(executor) == Status::working);
+	}
+	CHECK(waiter.updates == 1);
+
+	executor.state().set(SIGNAL, 1);
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(waiter.updates == 2);
+}
+
+TEST_CASE(watch_wired_input_of_child_tree_follows_parent_wire)
+{
+	Agent agent;
+	Tree parent(agent);
+	Tree child(agent);
+	Executor executor(agent);
+	executor.set_event_driven(true);
+
+	auto& waiter = child.root<Waiter>();
+	child.input(CHILD_SIGNAL);
+	child.input(waiter, CHILD_SIGNAL, Waiter::INPUT);
+
+	parent.root<Sequence>();
+	auto& proxy = parent.child(parent.root(), child);
+	parent.input(proxy, SIGNAL, CHILD_SIGNAL);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		CHECK(parent.execute(executor) == Status::working);
+	}
+	CHECK(waiter.updates == 1);
+
+	executor.state().set(SIGNAL, 1);
+	CHECK(parent.execute(executor) == Status::success);
+	CHECK(waiter.updates == 2);
+}
@@ -0,0 +1,61 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <cstring>
+#include "test.hpp"
+
+static test::Case* cases = nullptr;
+static std::size_t num_failures = 0;
+
+test::Case::Case(const char* name, Function function) :
+	name(name),
+	function(function),
+	next(cases)
+{
+	cases = this;
+}
+
+void test::fail(const char* file, int line, const char* expression)
+{
+	++num_failures;
+	std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+}
+
+// Runs every case, or only those whose name contains the first argument.
+int main(int argc, const char* argv[])
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	std::size_t num_run = 0;
+	std::size_t num_failed = 0;
+	for (auto current = cases; current != nullptr; current = current->next)
+	{
+		if (filter != nullptr && std::strstr(current->name, filter) == nullptr)
+		{
+			continue;
+		}
+
+		auto failures = num_failures;
+		current->function();
+		++num_run;
+
+		if (num_failures != failures)
+		{
+			++num_failed;
+			std::printf("FAIL: %s\n", current->name);
+		}
+		else
+		{
+			std::printf("PASS: %s\n", current->name);
+		}
+	}
+
+	std::printf("%zu of %zu cases passed\n", num_run - num_failed, num_run);
+	return num_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/primitives/primitives.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::Selector<Agent> Selector;
+	typedef bmashina::MemorySequence<Agent> MemorySequence;
+	typedef bmashina::MemorySelector<Agent> MemorySelector;
+	typedef bmashina::Status Status;
+
+	// Returns 'result' and counts its updates.
+	class Leaf : public Node
+	{
+	public:
+		Leaf(Status result) :
+			result(result)
+		{
+			// Nothing.
+		}
+
+		Status result;
+		int updates = 0;
+
+		Status update(Executor& executor) override
+		{
+			++updates;
+			return result;
+		}
+	};
+}
+
+TEST_CASE(memory_sequence_resumes_working_child)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	auto& root = tree.root<MemorySequence>();
+	auto& a = tree.child<Leaf>(root, Status::success);
+	auto& b = tree.child<Leaf>(root, Status::working);
+	auto& c = tree.child<Leaf>(root, Status::success);
+
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(a.updates == 1);
+	CHECK(b.updates == 2);
+	CHECK(c.updates == 0);
+
+	b.result = Status::success;
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(a.updates == 1);
+	CHECK(b.updates == 3);
+	CHECK(c.updates == 1);
+
+	// Finished; the next update starts over.
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(a.updates == 2);
+}
+
+TEST_CASE(memory_sequence_restarts_after_failure)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	auto& root = tree.root<MemorySequence>();
+	auto& a = tree.child<Leaf>(root, Status::success);
+	auto& b = tree.child<Leaf>(root, Status::working);
+
+	CHECK(tree.execute(executor) == Status::working);
+
+	b.result = Status::failure;
+	CHECK(tree.execute(executor) == Status::failure);
+	CHECK(a.updates == 1);
+	CHECK(b.updates == 2);
+
+	b.result = Status::working;
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(a.updates == 2);
+	CHECK(b.updates == 3);
+}
+
+TEST_CASE(memory_selector_resumes_and_restarts)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	auto& root = tree.root<MemorySelector>();
+	auto& a = tree.child<Leaf>(root, Status::failure);
+	auto& b = tree.child<Leaf>(root, Status::working);
+	auto& c = tree.child<Leaf>(root, Status::success);
+
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(a.updates == 1);
+	CHECK(b.updates == 2);
+
+	// Success is not the continue status, so it ends the selector and the
+	// next update starts over.
+	b.result = Status::success;
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(a.updates == 1);
+	CHECK(c.updates == 0);
+
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(a.updates == 2);
+	CHECK(b.updates == 4);
+
+	// Every child failing fails the selector.
+	b.result = Status::failure;
+	c.result = Status::failure;
+	CHECK(tree.execute(executor) == Status::failure);
+	CHECK(c.updates == 1);
+}
+
+TEST_CASE(memory_sequence_forgets_resume_when_dropped)
+{
+	Agent agent;
+	Tree tree(agent);
+	Executor executor(agent);
+
+	auto& root = tree.root<Selector>();
+	auto& guard = tree.child<Leaf>(root, Status::failure);
+	auto& sequence = tree.child<MemorySequence>(root);
+	auto& a = tree.child<Leaf>(sequence, Status::success);
+	auto& b = tree.child<Leaf>(sequence, Status::working);
+
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(a.updates == 1);
+	CHECK(b.updates == 2);
+
+	// The selector switches to the guard, dropping the sequence's frame and
+	// its resume point with it.
+	guard.result = Status::success;
+	CHECK(tree.execute(executor) == Status::success);
+
+	guard.result = Status::failure;
+	CHECK(tree.execute(executor) == Status::working);
+	CHECK(a.updates == 2);
+	CHECK(b.updates == 3);
+}
@@ -0,0 +1,271 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <string>
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+}
+
+#include "bmashina/config.hpp"
+#include "bmashina/trace/profileTracer.hpp"
+
+namespace bmashina
+{
+	template <>
+	struct Tracer<Agent>
+	{
+		typedef ProfileTracer<Agent> Type;
+	};
+}
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/primitives/primitives.hpp"
+
+namespace
+{
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::Sequence<Agent> Sequence;
+	typedef bmashina::NodeProfile NodeProfile;
+	typedef bmashina::Status Status;
+
+	class Leaf : public Node
+	{
+	public:
+		Status result = Status::success;
+
+		Status update(Executor& executor) override
+		{
+			return result;
+		}
+	};
+
+	// Updates its first child on even ticks and its second on odd ticks, so
+	// the child not updated is dropped and deactivated.
+	class Switch : public Node
+	{
+	public:
+		int tick = 0;
+
+		Status update(Executor& executor) override
+		{
+			auto child = tree().children_begin(*this);
+			if (tick++ % 2 == 1)
+			{
+				++child;
+			}
+
+			return executor.update(*child);
+		}
+	};
+
+	// Visits its child without updating it.
+	class Peek : public Node
+	{
+	public:
+		Status update(Executor& executor) override
+		{
+			executor.visit(*tree().children_begin(*this));
+			return Status::working;
+		}
+	};
+
+	// Sequence { Switch { first, second }, Peek { peeked } }
+	struct Fixture
+	{
+		Agent agent;
+		Tree tree;
+		Executor executor;
+
+		Sequence* root;
+		Switch* switcher;
+		Leaf* first;
+		Leaf* second;
+		Peek* peek;
+		Leaf* peeked;
+
+		Fixture() :
+			tree(agent),
+			executor(agent)
+		{
+			root = &tree.root<Sequence>();
+			switcher = &tree.child<Switch>(*root);
+			first = &tree.child<Leaf>(*switcher);
+			second = &tree.child<Leaf>(*switcher);
+			peek = &tree.child<Peek>(*root);
+			peeked = &tree.child<Leaf>(*peek);
+		}
+
+		const NodeProfile& get(const Node& node)
+		{
+			static const NodeProfile empty;
+
+			auto result = executor.get_tracer().get_profile(node);
+			CHECK(result != nullptr);
+
+			return result != nullptr ? *result : empty;
+		}
+	};
+}
+
+TEST_CASE(profile_tracer_counts_statuses)
+{
+	Fixture fixture;
+	fixture.second->result = Status::failure;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		fixture.tree.execute(fixture.executor);
+	}
+
+	// Ticks 0 and 2 reach the peek; tick 1 fails in the switch.
+	auto& root = fixture.get(*fixture.root);
+	CHECK(root.visits == 3);
+	CHECK(root.statuses[(int)Status::working] == 2);
+	CHECK(root.statuses[(int)Status::failure] == 1);
+
+	auto& first = fixture.get(*fixture.first);
+	CHECK(first.visits == 2);
+	CHECK(first.statuses[(int)Status::success] == 2);
+	CHECK(first.statuses[(int)Status::failure] == 0);
+
+	auto& second = fixture.get(*fixture.second);
+	CHECK(second.visits == 1);
+	CHECK(second.statuses[(int)Status::failure] == 1);
+
+	// Visited, never updated.
+	auto& peeked = fixture.get(*fixture.peeked);
+	CHECK(peeked.visits == 2);
+	CHECK(peeked.statuses[(int)Status::none] == 2);
+	CHECK(peeked.statuses[(int)Status::success] == 0);
+}
+
+TEST_CASE(profile_tracer_counts_activations)
+{
+	Fixture fixture;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		fixture.tree.execute(fixture.executor);
+	}
+
+	// Each tick drops the child of the switch updated on the previous one.
+	auto& first = fixture.get(*fixture.first);
+	CHECK(first.activations == 2);
+	CHECK(first.deactivations == 1);
+
+	auto& second = fixture.get(*fixture.second);
+	CHECK(second.activations == 1);
+	CHECK(second.deactivations == 1);
+
+	// Visiting a node activates it, too.
+	auto& peeked = fixture.get(*fixture.peeked);
+	CHECK(peeked.activations == 1);
+	CHECK(peeked.deactivations == 0);
+
+	CHECK(fixture.executor.is_active(*fixture.first));
+	CHECK(!fixture.executor.is_active(*fixture.second));
+}
+
+TEST_CASE(profile_tracer_splits_time)
+{
+	Fixture fixture;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		fixture.tree.execute(fixture.executor);
+	}
+
+	// Exclusive time is inclusive time less that of the nodes entered.
+	auto& root = fixture.get(*fixture.root);
+	auto& switcher = fixture.get(*fixture.switcher);
+	auto& peek = fixture.get(*fixture.peek);
+	CHECK(root.inclusive >= root.exclusive);
+	CHECK(root.inclusive == root.exclusive + switcher.inclusive + peek.inclusive);
+
+	auto& first = fixture.get(*fixture.first);
+	auto& second = fixture.get(*fixture.second);
+	CHECK(switcher.inclusive == switcher.exclusive + first.inclusive + second.inclusive);
+
+	auto& peeked = fixture.get(*fixture.peeked);
+	CHECK(peek.inclusive == peek.exclusive + peeked.inclusive);
+
+	// Leaves enter nothing.
+	CHECK(first.inclusive == first.exclusive);
+	CHECK(peeked.inclusive == peeked.exclusive);
+}
+
+TEST_CASE(profile_tracer_disable_and_reset)
+{
+	Fixture fixture;
+	auto& tracer = fixture.executor.get_tracer();
+
+	tracer.set_enabled(false);
+	fixture.tree.execute(fixture.executor);
+	CHECK(tracer.get_profile(*fixture.root) == nullptr);
+
+	tracer.set_enabled(true);
+	fixture.tree.execute(fixture.executor);
+	CHECK(fixture.get(*fixture.root).visits == 1);
+
+	// Activated while disabled, then dropped for the second leaf.
+	auto& first = fixture.get(*fixture.first);
+	CHECK(first.visits == 0);
+	CHECK(first.activations == 0);
+	CHECK(first.deactivations == 1);
+
+	tracer.reset(fixture.tree);
+	CHECK(tracer.get_profile(*fixture.root) == nullptr);
+}
+
+TEST_CASE(profile_tracer_dump)
+{
+	Fixture fixture;
+	fixture.tree.execute(fixture.executor);
+
+	std::FILE* file = std::tmpfile();
+	CHECK(file != nullptr);
+	if (file == nullptr)
+	{
+		return;
+	}
+
+	fixture.executor.get_tracer().dump(fixture.tree, file);
+
+	std::string result;
+	std::rewind(file);
+	char buffer[256];
+	std::size_t count;
+	while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		result.append(buffer, count);
+	}
+	std::fclose(file);
+
+	CHECK(result.find(" visits       none    success ") != std::string::npos);
+
+	// The peeked leaf, ordinal 5: one visit, counted as none.
+	char row[64];
+	std::snprintf(row, sizeof(row), "%8d %10d %10d %10d", 5, 1, 1, 0);
+	CHECK(result.find(row) != std::string::npos);
+
+	// The second leaf was neither visited nor activated.
+	std::snprintf(row, sizeof(row), "\n%8d ", 3);
+	CHECK(result.find(row) == std::string::npos);
+}
@@ -0,0 +1,252 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <string>
+#include "bmashina/bmashina.hpp"
+#include "bmashina/primitives/primitives.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+
+	typedef bmashina::BasicState<Agent> State;
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::Sequence<Agent> Sequence;
+	typedef bmashina::Status Status;
+
+	// Longer than any small string buffer, so the value lives in a
+	// heap-allocated property.
+	const std::string LONG_TEXT(64, 'a');
+
+	// Records whether a reference is visible when updated, and its value.
+	class Probe : public Node
+	{
+	public:
+		Probe(const bmashina::Local<int>& reference) :
+			reference(&reference)
+		{
+			// Nothing.
+		}
+
+		const bmashina::Local<int>* reference;
+		bool visible = false;
+		int value = 0;
+
+		Status update(Executor& executor) override
+		{
+			visible = executor.state().has(*reference);
+			value = executor.state().get(*reference, -1);
+
+			return Status::success;
+		}
+	};
+}
+
+TEST_CASE(state_reads_through_fallback)
+{
+	Agent agent;
+	State constants(agent);
+	State state(agent);
+	bmashina::Local<int> value;
+
+	constants.set(value, 1);
+	CHECK(!state.has(value));
+
+	state.set_fallback(&constants);
+	CHECK(state.get_fallback() == &constants);
+	CHECK(state.has(value));
+	CHECK(state.get(value) == 1);
+	CHECK(state.get_as<int>(value) != nullptr);
+
+	state.set_fallback(nullptr);
+	CHECK(!state.has(value));
+}
+
+TEST_CASE(state_local_write_shadows_fallback)
+{
+	Agent agent;
+	State constants(agent);
+	State state(agent);
+	state.set_fallback(&constants);
+	bmashina::Local<int> value;
+
+	constants.set(value, 1);
+	state.set(value, 2);
+	CHECK(state.get(value) == 2);
+	CHECK(constants.get(value) == 1);
+
+	// Unsetting the local value exposes the fallback's again.
+	state.unset(value);
+	CHECK(state.get(value) == 1);
+	CHECK(constants.get(value) == 1);
+}
+
+TEST_CASE(state_move_copies_fallback_value)
+{
+	Agent agent;
+	State constants(agent);
+	State state(agent);
+	state.set_fallback(&constants);
+	bmashina::Local<std::string> source;
+	bmashina::Reference<std::string> destination;
+
+	constants.set(source, LONG_TEXT);
+	State::move(state, source, destination);
+
+	CHECK(state.get(destination) == LONG_TEXT);
+	CHECK(constants.get(source) == LONG_TEXT);
+	CHECK(state.get(source) == LONG_TEXT);
+
+	// The moved value is independent of the fallback.
+	constants.set(source, std::string("b"));
+	CHECK(state.get(destination) == LONG_TEXT);
+}
+
+TEST_CASE(state_fallback_restored_after_child_tree)
+{
+	Agent agent;
+	Tree parent(agent);
+	Tree child(agent);
+	Executor executor(agent);
+
+	auto& parent_constant = parent.constant<int>(1);
+	auto& child_constant = child.constant<int>(2);
+
+	parent.root<Sequence>();
+	auto& before = parent.child<Probe>(parent.root(), parent_constant);
+	parent.child(parent.root(), child);
+	auto& after = parent.child<Probe>(parent.root(), parent_constant);
+	auto& hidden = parent.child<Probe>(parent.root(), child_constant);
+
+	child.root<Sequence>();
+	auto& inside = child.child<Probe>(child.root(), child_constant);
+	auto& outside = child.child<Probe>(child.root(), parent_constant);
+
+	CHECK(parent.execute(executor) == Status::success);
+	CHECK(before.visible && before.value == 1);
+	CHECK(inside.visible && inside.value == 2);
+	CHECK(!outside.visible);
+	CHECK(after.visible && after.value == 1);
+	CHECK(!hidden.visible);
+
+	// Constants are only visible while their tree executes.
+	CHECK(!executor.state().has(parent_constant));
+	CHECK(executor.state().get_fallback() == nullptr);
+}
+
+TEST_CASE(state_stale_locals_read_as_unset)
+{
+	Agent agent;
+	State state(agent);
+	bmashina::Local<int> number;
+	bmashina::Local<std::string> text;
+	bmashina::Local<int> other;
+	bmashina::Reference<int> shared;
+	int first_key, second_key;
+
+	state.set_locals_key(&first_key);
+	state.set(number, 1);
+	state.set(text, LONG_TEXT);
+	state.set(shared, 3);
+
+	state.set_locals_key(&second_key);
+	state.set(other, 2);
+
+	state.invalidate_locals(&first_key);
+	CHECK(!state.has(number));
+	CHECK(!state.has(text));
+	CHECK(state.get(number, -1) == -1);
+	CHECK(state.get_as<int>(number) == nullptr);
+
+	// Locals of other scopes and references are not affected.
+	CHECK(state.get(other, -1) == 2);
+	CHECK(state.get(shared, -1) == 3);
+
+	// Invalidating a key without a scope does nothing.
+	int unused_key;
+	state.invalidate_locals(&unused_key);
+	CHECK(state.get(other, -1) == 2);
+}
+
+TEST_CASE(state_invalidation_changes_revision)
+{
+	Agent agent;
+	State state(agent);
+	bmashina::Local<int> value;
+	bmashina::Local<int> unset;
+	bmashina::Reference<int> shared;
+
+	auto scope = state.get_locals_scope(&value);
+	state.set_locals_scope(scope);
+	state.set(value, 1);
+	state.set(shared, 2);
+
+	auto revision = state.get_revision();
+	auto value_revision = state.get_revision(value);
+	auto shared_revision = state.get_revision(shared);
+	auto unset_revision = state.get_revision(unset);
+
+	state.invalidate_locals_scope(scope);
+	CHECK(state.get_revision() > revision);
+	CHECK(state.get_revision(value) > value_revision);
+	CHECK(state.get_revision(value) == state.get_revision());
+	CHECK(state.get_revision(shared) == shared_revision);
+	CHECK(state.get_revision(unset) == unset_revision);
+
+	// Invalidating again is another change.
+	value_revision = state.get_revision(value);
+	state.invalidate_locals_scope(scope);
+	CHECK(state.get_revision(value) > value_revision);
+}
+
+TEST_CASE(state_reuses_slot_after_invalidation)
+{
+	Agent agent;
+	State state(agent);
+	bmashina::Local<int> number;
+	bmashina::Local<std::string> text;
+	int key;
+
+	state.set_locals_key(&key);
+	state.set(number, 1);
+	state.set(text, LONG_TEXT);
+	state.invalidate_locals(&key);
+
+	// The stale values are replaced, not read back.
+	state.set(number, 2);
+	state.set(text, std::string("b"));
+	CHECK(state.get(number) == 2);
+	CHECK(state.get(text) == "b");
+
+	auto revision = state.get_revision(number);
+	state.invalidate_locals(&key);
+	CHECK(!state.has(number));
+	CHECK(state.get_revision(number) > revision);
+
+	// Copying a stale local copies nothing, like a local never set.
+	bmashina::Local<int> never_set;
+	bmashina::Reference<int> destination;
+	state.set(destination, 3);
+	State::copy(state, state, never_set, destination);
+	CHECK(state.get(destination) == 3);
+	State::copy(state, state, number, destination);
+	CHECK(state.get(destination) == 3);
+
+	state.set(text, LONG_TEXT);
+	CHECK(state.get(text) == LONG_TEXT);
+	CHECK(!state.has(number));
+}
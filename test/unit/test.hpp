@@ -0,0 +1,46 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#ifndef BMASHINA_TEST_UNIT_TEST_HPP
+#define BMASHINA_TEST_UNIT_TEST_HPP
+
+namespace test
+{
+	typedef void (*Function)();
+
+	// A test case registers itself when its file's statics are initialized.
+	// Cases run in an unspecified order; each must set up its own trees and
+	// executors.
+	struct Case
+	{
+		Case(const char* name, Function function);
+
+		const char* name;
+		Function function;
+		Case* next;
+	};
+
+	// Records a failed check in the running case and keeps going.
+	void fail(const char* file, int line, const char* expression);
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static test::Case name##_case(#name, &name); \
+	static void name()
+
+#define CHECK(expression) \
+	do \
+	{ \
+		if (!(expression)) \
+		{ \
+			test::fail(__FILE__, __LINE__, #expression); \
+		} \
+	} while (0)
+
+#endif
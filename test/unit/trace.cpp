@@ -0,0 +1,174 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bmashina/trace/chromeTrace.hpp"
+#include "bmashina/trace/traceRing.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Writes dump as a Chrome trace and returns the result, or an empty
+	// string if the dump was rejected.
+	std::string write_chrome_trace(const std::vector<unsigned char>& dump, std::size_t size)
+	{
+		std::FILE* file = std::tmpfile();
+		if (file == nullptr)
+		{
+			return std::string();
+		}
+
+		bool success = bmashina::write_chrome_trace(dump.data(), size, file);
+
+		std::string result;
+		if (success)
+		{
+			std::rewind(file);
+
+			char buffer[256];
+			std::size_t count;
+			while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+			{
+				result.append(buffer, count);
+			}
+		}
+		std::fclose(file);
+
+		return result;
+	}
+
+	std::string get_name(const char* prefix, const void* object, std::uint32_t ordinal)
+	{
+		char result[64];
+		std::snprintf(
+			result, sizeof(result), "\"%s 0x%llx node %u\"",
+			prefix, (unsigned long long)(std::uintptr_t)object, (unsigned)ordinal);
+		return result;
+	}
+}
+
+TEST_CASE(trace_ring_keeps_newest_events)
+{
+	bmashina::TraceRing ring(5);
+	CHECK(ring.get_capacity() == 8);
+
+	int node;
+	for (std::uint32_t i = 0; i < 20; ++i)
+	{
+		ring.record(bmashina::trace_event_node_enter, &node, i, 1, 0);
+	}
+
+	// Snapshots leave out the oldest slot once the ring has wrapped, since
+	// a writer on another thread could be overwriting it.
+	std::vector<bmashina::TraceEvent> events;
+	ring.snapshot(events);
+	CHECK(events.size() >= ring.get_capacity() - 1);
+	CHECK(events.size() <= ring.get_capacity());
+	CHECK(!events.empty() && events.back().ordinal == 19);
+	for (std::size_t i = 0; i < events.size(); ++i)
+	{
+		CHECK(events[i].ordinal == 20 - events.size() + i);
+		CHECK(events[i].type == bmashina::trace_event_node_enter);
+		CHECK(events[i].object == (std::uint64_t)(std::uintptr_t)&node);
+		CHECK(events[i].depth == 1);
+	}
+
+	for (std::size_t i = 1; i < events.size(); ++i)
+	{
+		CHECK(events[i].timestamp >= events[i - 1].timestamp);
+	}
+
+	ring.clear();
+	events.clear();
+	ring.snapshot(events);
+	CHECK(events.empty());
+
+	ring.record(bmashina::trace_event_node_leave, &node, 20, 1, 0);
+	ring.snapshot(events);
+	CHECK(events.size() == 1 && events[0].ordinal == 20);
+}
+
+TEST_CASE(chrome_trace_names_nodes_by_tree)
+{
+	bmashina::TraceRing ring(64);
+
+	// Node 0 of two trees, the second entered from the first.
+	int first, second, node;
+	ring.record(bmashina::trace_event_node_leave, &node, 7, 2, 0);
+	ring.record(bmashina::trace_event_tree_enter, &first, 0, 0, 0);
+	ring.record(bmashina::trace_event_node_enter, &node, 0, 1, 0);
+	ring.record(bmashina::trace_event_tree_enter, &second, 0, 1, 0);
+	ring.record(bmashina::trace_event_node_enter, &node, 0, 2, 0);
+	ring.record(bmashina::trace_event_node_leave, &node, 0, 2, 1);
+	ring.record(bmashina::trace_event_tree_leave, &second, 0, 1, 0);
+	ring.record(bmashina::trace_event_node_leave, &node, 0, 1, 1);
+	ring.record(bmashina::trace_event_tree_leave, &first, 0, 0, 0);
+
+	std::vector<unsigned char> dump;
+	bmashina::TraceRing::dump(dump);
+
+	auto trace = write_chrome_trace(dump, dump.size());
+	CHECK(!trace.empty());
+	CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+	CHECK(trace.find(get_name("tree", &first, 0)) != std::string::npos);
+	CHECK(trace.find(get_name("tree", &second, 0)) != std::string::npos);
+
+	// Recorded before any tree was entered.
+	CHECK(trace.find("\"node 7\"") != std::string::npos);
+	CHECK(trace.find("\"status\":\"success\"") != std::string::npos);
+}
+
+TEST_CASE(chrome_trace_rejects_bad_dumps)
+{
+	bmashina::TraceRing ring(8);
+	int tree;
+	ring.record(bmashina::trace_event_tree_enter, &tree, 0, 0, 0);
+	ring.record(bmashina::trace_event_tree_leave, &tree, 0, 0, 0);
+
+	std::vector<unsigned char> dump;
+	bmashina::TraceRing::dump(dump);
+	CHECK(!write_chrome_trace(dump, dump.size()).empty());
+
+	for (std::size_t size = 0; size < dump.size(); ++size)
+	{
+		if (!write_chrome_trace(dump, size).empty())
+		{
+			test::fail(__FILE__, __LINE__, "write_chrome_trace(truncated)");
+			break;
+		}
+	}
+
+	// Header: magic, version, ring count, reserved, frequency.
+	auto corrupt = dump;
+	corrupt[0] ^= 0xff;
+	CHECK(write_chrome_trace(corrupt, corrupt.size()).empty());
+
+	corrupt = dump;
+	corrupt[4] ^= 0xff;
+	CHECK(write_chrome_trace(corrupt, corrupt.size()).empty());
+
+	corrupt = dump;
+	double frequency = 0.0;
+	std::memcpy(&corrupt[16], &frequency, sizeof(frequency));
+	CHECK(write_chrome_trace(corrupt, corrupt.size()).empty());
+
+	// More rings than the dump holds.
+	corrupt = dump;
+	std::uint32_t num_rings = 1000;
+	std::memcpy(&corrupt[8], &num_rings, sizeof(num_rings));
+	CHECK(write_chrome_trace(corrupt, corrupt.size()).empty());
+
+	// More events in the first ring than the dump holds.
+	corrupt = dump;
+	std::uint32_t num_events = 0xffffffff;
+	std::memcpy(&corrupt[28], &num_events, sizeof(num_events));
+	CHECK(write_chrome_trace(corrupt, corrupt.size()).empty());
+}
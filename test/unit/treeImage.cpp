@@ -0,0 +1,372 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bmashina/bmashina.hpp"
+#include "bmashina/builder/nativeDictionary.hpp"
+#include "bmashina/builder/treeImage.hpp"
+#include "bmashina/primitives/primitives.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::Sequence<Agent> Sequence;
+	typedef bmashina::NativeNodeDictionary<Agent> Dictionary;
+	typedef bmashina::Status Status;
+	typedef bmashina::TreeImage TreeImage;
+	typedef bmashina::TreeImageWriter TreeImageWriter;
+
+	bmashina::Reference<double> TOTAL("total");
+
+	// Adds its inputs and writes the sum to its output.
+	class Add : public Node
+	{
+	public:
+		static bmashina::Reference<double> A;
+		static bmashina::Reference<double> B;
+		static bmashina::Reference<double> RESULT;
+
+		Status update(Executor& executor) override
+		{
+			auto& state = executor.state();
+			state.set(RESULT, state.get(A, 0.0) + state.get(B, 0.0));
+
+			return Status::success;
+		}
+	};
+
+	bmashina::Reference<double> Add::A("a");
+	bmashina::Reference<double> Add::B("b");
+	bmashina::Reference<double> Add::RESULT("result");
+
+	// Succeeds if its inputs match the constants written by write_image.
+	class Check : public Node
+	{
+	public:
+		static bmashina::Reference<std::string> NAME;
+		static bmashina::Reference<int> COUNT;
+		static bmashina::Reference<bool> FLAG;
+
+		Status update(Executor& executor) override
+		{
+			auto& state = executor.state();
+			if (state.get(NAME, std::string()) == "hello" &&
+				state.get(COUNT, 0) == 3 &&
+				state.get(FLAG, false))
+			{
+				return Status::success;
+			}
+
+			return Status::failure;
+		}
+	};
+
+	bmashina::Reference<std::string> Check::NAME("name");
+	bmashina::Reference<int> Check::COUNT("count");
+	bmashina::Reference<bool> Check::FLAG("flag");
+
+	const bmashina::detail::BaseReference* resolve(const char* name)
+	{
+		const bmashina::detail::BaseReference* references[] =
+		{
+			&TOTAL, &Add::A, &Add::B, &Add::RESULT, &Check::NAME, &Check::COUNT, &Check::FLAG
+		};
+
+		for (auto reference: references)
+		{
+			if (std::strcmp(reference->name, name) == 0)
+			{
+				return reference;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Sequence { Add(a = 1, b = 2) -> total, Add(a = total, b = 0.5) -> total,
+	// Check(name, count, flag) }
+	void write_image(std::vector<unsigned char>& result)
+	{
+		TreeImageWriter writer;
+		auto root = writer.root("Sequence");
+
+		auto first = writer.child(root, "Add");
+		writer.constant(first, 1.0, "a");
+		writer.constant(first, 2.0, "b");
+		writer.output(first, "result", "total");
+
+		auto second = writer.child(root, "Add");
+		writer.input(second, "total", "a");
+		writer.constant(second, 0.5, "b");
+		writer.output(second, "result", "total");
+
+		auto check = writer.child(root, "Check");
+		writer.constant(check, std::string("hello"), "name");
+		writer.constant(check, 3, "count");
+		writer.constant(check, true, "flag");
+
+		writer.write(result);
+	}
+
+	void define(Dictionary& dictionary)
+	{
+		dictionary.define<Sequence>("Sequence");
+		dictionary.define<Add>("Add");
+		dictionary.define<Check>("Check");
+	}
+
+	// Section offsets of an image written by TreeImageWriter.
+	struct Layout
+	{
+		bmashina::detail::TreeImageHeader* header;
+		bmashina::detail::TreeImageNode* nodes;
+		std::uint32_t* children;
+		bmashina::detail::TreeImageWire* wires;
+		bmashina::detail::TreeImageConstant* constants;
+	};
+
+	Layout get_layout(std::vector<unsigned char>& image)
+	{
+		using namespace bmashina::detail;
+
+		Layout result;
+		result.header = reinterpret_cast<TreeImageHeader*>(image.data());
+
+		auto offset = tree_image_align(sizeof(TreeImageHeader));
+		result.nodes = reinterpret_cast<TreeImageNode*>(image.data() + offset);
+		offset = tree_image_align(offset + result.header->num_nodes * sizeof(TreeImageNode));
+		result.children = reinterpret_cast<std::uint32_t*>(image.data() + offset);
+		offset = tree_image_align(offset + result.header->num_children * sizeof(std::uint32_t));
+		result.wires = reinterpret_cast<TreeImageWire*>(image.data() + offset);
+		offset = tree_image_align(offset + result.header->num_wires * sizeof(TreeImageWire));
+		result.constants = reinterpret_cast<TreeImageConstant*>(image.data() + offset);
+
+		return result;
+	}
+}
+
+TEST_CASE(tree_image_round_trip)
+{
+	std::vector<unsigned char> data;
+	write_image(data);
+
+	TreeImage image;
+	CHECK(image.load(data.data(), data.size()));
+	CHECK(image.valid());
+	CHECK(image.size() == data.size());
+	CHECK(image.get_num_nodes() == 4);
+	CHECK(std::strcmp(image.get_key(0), "Sequence") == 0);
+	CHECK(std::strcmp(image.get_key(3), "Check") == 0);
+
+	Agent agent;
+	Dictionary dictionary(agent);
+	define(dictionary);
+
+	Tree tree(agent);
+	image.materialize(tree, dictionary, &resolve);
+	CHECK(tree.compiled());
+
+	Executor executor(agent);
+	CHECK(tree.execute(executor) == Status::success);
+	CHECK(executor.state().get(TOTAL, 0.0) == 3.5);
+
+	// Wired inputs are unset again after each node.
+	CHECK(!executor.state().has(Add::A));
+	CHECK(!executor.state().has(Check::NAME));
+}
+
+TEST_CASE(tree_image_open_file)
+{
+	TreeImageWriter writer;
+	auto root = writer.root("Sequence");
+	writer.child(root, "Add");
+
+	const char* filename = "test_unit_tree_image.bmti";
+	CHECK(writer.save(filename));
+
+	TreeImage image;
+	CHECK(image.open(filename));
+	CHECK(image.get_num_nodes() == 2);
+	CHECK(std::strcmp(image.get_key(1), "Add") == 0);
+
+	image.close();
+	CHECK(!image.valid());
+	std::remove(filename);
+
+	CHECK(!image.open(filename));
+}
+
+TEST_CASE(tree_image_rejects_bad_header)
+{
+	std::vector<unsigned char> data;
+	write_image(data);
+
+	TreeImage image;
+	auto image_data = data;
+	get_layout(image_data).header->magic = 0;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+	CHECK(!image.valid());
+
+	image_data = data;
+	get_layout(image_data).header->version = 1;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// As read on a host of the other byte order.
+	image_data = data;
+	get_layout(image_data).header->byte_order = 0x04030201;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	get_layout(image_data).header->num_nodes = 0;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	CHECK(!image.load(nullptr, 0));
+	CHECK(image.load(data.data(), data.size()));
+}
+
+TEST_CASE(tree_image_rejects_truncation)
+{
+	std::vector<unsigned char> data;
+	write_image(data);
+
+	TreeImage image;
+	for (std::size_t size = 0; size < data.size(); ++size)
+	{
+		if (image.load(data.data(), size))
+		{
+			test::fail(__FILE__, __LINE__, "image.load(truncated)");
+			break;
+		}
+	}
+
+	// Section sizes larger than the image.
+	auto image_data = data;
+	get_layout(image_data).header->num_wires = 0x40000000;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	get_layout(image_data).header->strings_size = 0xffffffff;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// Strings must be terminated.
+	image_data = data;
+	image_data.back() = 'x';
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// Images are read in place, so they must be aligned.
+	std::vector<unsigned char> unaligned(data.size() + 1);
+	std::memcpy(unaligned.data() + 1, data.data(), data.size());
+	CHECK(!image.load(unaligned.data() + 1, data.size()));
+}
+
+TEST_CASE(tree_image_rejects_bad_hierarchy)
+{
+	std::vector<unsigned char> data;
+	write_image(data);
+
+	TreeImage image;
+
+	// Node 2 claimed by both the root and node 1.
+	auto image_data = data;
+	auto layout = get_layout(image_data);
+	layout.children[0] = 2;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// A child before its parent (here, the root itself).
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.children[0] = 0;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// A child out of range.
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.children[2] = 4;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// Node 3 has no parent.
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.nodes[0].children_end = 2;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// Child span out of range.
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.nodes[0].children_end = layout.header->num_children + 1;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.nodes[1].key = layout.header->strings_size;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+}
+
+TEST_CASE(tree_image_rejects_bad_wires)
+{
+	std::vector<unsigned char> data;
+	write_image(data);
+
+	TreeImage image;
+
+	// Input span past the outputs.
+	auto image_data = data;
+	auto layout = get_layout(image_data);
+	layout.nodes[1].inputs_end = layout.nodes[1].outputs_begin + 1;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.nodes[3].outputs_end = layout.header->num_wires + 1;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// The first wire is the constant 'a' of the first Add.
+	image_data = data;
+	layout = get_layout(image_data);
+	CHECK(layout.wires[0].flags == bmashina::detail::tree_image_wire_constant);
+	layout.wires[0].from = layout.header->num_constants;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.wires[0].flags = 0;
+	layout.wires[0].from = layout.header->strings_size;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.wires[0].to = layout.header->strings_size;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	// Constant values outside the payload.
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.constants[0].offset = layout.header->payload_size;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	image_data = data;
+	layout = get_layout(image_data);
+	layout.constants[0].size = 0xfffffff8;
+	CHECK(!image.load(image_data.data(), image_data.size()));
+
+	CHECK(image.load(data.data(), data.size()));
+}
@@ -0,0 +1,153 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include "bmashina/bmashina.hpp"
+#include "bmashina/primitives/primitives.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct Agent
+	{
+		bool operator ==(const Agent& other) const
+		{
+			return true;
+		}
+	};
+
+	typedef bmashina::BasicTree<Agent> Tree;
+	typedef bmashina::BasicNode<Agent> Node;
+	typedef bmashina::BasicExecutor<Agent> Executor;
+	typedef bmashina::BasicTreeInstance<Agent> Instance;
+	typedef bmashina::Sequence<Agent> Sequence;
+	typedef bmashina::Status Status;
+
+	const int CHANNEL = 1;
+
+	// Records the last value of its input and counts its updates.
+	class Probe : public Node
+	{
+	public:
+		static bmashina::Reference<int> INPUT;
+
+		int value = 0;
+		int updates = 0;
+
+		Status update(Executor& executor) override
+		{
+			++updates;
+			value = executor.state().get(INPUT, -1);
+
+			return Status::success;
+		}
+	};
+
+	bmashina::Reference<int> Probe::INPUT;
+
+	// Template: Sequence { Probe(INPUT = 1), channel }, with the channel
+	// assigned to 'assigned'.
+	struct Fixture
+	{
+		Agent agent;
+		Tree tree;
+		Tree assigned;
+		Tree other;
+		Executor executor;
+
+		Probe* probe;
+		Probe* assigned_probe;
+		Probe* other_probe;
+		const bmashina::Local<int>* constant;
+
+		Fixture() :
+			tree(agent),
+			assigned(agent),
+			other(agent),
+			executor(agent)
+		{
+			tree.root<Sequence>();
+			probe = &tree.child<Probe>(tree.root());
+			constant = &tree.constant<int>(1);
+			tree.input(*probe, *constant, Probe::INPUT);
+			tree.child(tree.root(), CHANNEL);
+
+			assigned_probe = &assigned.root<Probe>();
+			other_probe = &other.root<Probe>();
+			tree.assign(CHANNEL, assigned);
+		}
+	};
+}
+
+TEST_CASE(tree_instance_without_overrides_matches_template)
+{
+	Fixture fixture;
+	Instance instance(fixture.agent, fixture.tree);
+
+	CHECK(&instance.get_template() == &fixture.tree);
+	CHECK(&instance.get_constants() == &fixture.tree.get_constants());
+	CHECK(!instance.assigned(CHANNEL));
+	CHECK(instance.get_assignment(CHANNEL) == nullptr);
+
+	// Resetting a constant that was never overridden does nothing.
+	instance.reset(*fixture.constant);
+	CHECK(&instance.get_constants() == &fixture.tree.get_constants());
+
+	CHECK(instance.execute(fixture.executor) == Status::success);
+	CHECK(fixture.probe->value == 1);
+	CHECK(fixture.assigned_probe->updates == 1);
+	CHECK(fixture.other_probe->updates == 0);
+}
+
+TEST_CASE(tree_instance_overrides_constant)
+{
+	Fixture fixture;
+	Instance instance(fixture.agent, fixture.tree);
+
+	instance.constant(*fixture.constant, bmashina::Property<int>(2));
+	CHECK(&instance.get_constants() != &fixture.tree.get_constants());
+
+	CHECK(instance.execute(fixture.executor) == Status::success);
+	CHECK(fixture.probe->value == 2);
+
+	// The template and other instances keep the template's value.
+	CHECK(fixture.tree.execute(fixture.executor) == Status::success);
+	CHECK(fixture.probe->value == 1);
+
+	Instance other(fixture.agent, fixture.tree);
+	CHECK(other.execute(fixture.executor) == Status::success);
+	CHECK(fixture.probe->value == 1);
+
+	instance.reset(*fixture.constant);
+	CHECK(instance.execute(fixture.executor) == Status::success);
+	CHECK(fixture.probe->value == 1);
+}
+
+TEST_CASE(tree_instance_overrides_channel)
+{
+	Fixture fixture;
+	Instance instance(fixture.agent, fixture.tree);
+
+	instance.assign(CHANNEL, fixture.other);
+	CHECK(instance.assigned(CHANNEL));
+	CHECK(instance.get_assignment(CHANNEL) == &fixture.other);
+
+	CHECK(instance.execute(fixture.executor) == Status::success);
+	CHECK(fixture.other_probe->updates == 1);
+	CHECK(fixture.assigned_probe->updates == 0);
+
+	// The template keeps its own assignment.
+	CHECK(fixture.tree.execute(fixture.executor) == Status::success);
+	CHECK(fixture.other_probe->updates == 1);
+	CHECK(fixture.assigned_probe->updates == 1);
+
+	instance.unassign(CHANNEL);
+	CHECK(!instance.assigned(CHANNEL));
+	CHECK(instance.execute(fixture.executor) == Status::success);
+	CHECK(fixture.other_probe->updates == 1);
+	CHECK(fixture.assigned_probe->updates == 2);
+}
@@ -0,0 +1,73 @@
+// BMASHINA
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+// Copyright 2017 [bk]door.maus
+
+#include <cstdio>
+#include <vector>
+#include "bmashina/trace/chromeTrace.hpp"
+
+static bool read_file(const char* filename, std::vector<unsigned char>& result)
+{
+	std::FILE* file = std::fopen(filename, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	unsigned char buffer[4096];
+	std::size_t count;
+	while ((count = std::fread(buffer, 1, sizeof(buffer), file)) != 0)
+	{
+		result.insert(result.end(), buffer, buffer + count);
+	}
+
+	bool success = !std::ferror(file);
+	std::fclose(file);
+
+	return success;
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::fprintf(stderr, "usage: %s <trace.bmtr> [trace.json]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<unsigned char> data;
+	if (!read_file(argv[1], data))
+	{
+		std::fprintf(stderr, "couldn't read '%s'\n", argv[1]);
+		return 1;
+	}
+
+	std::FILE* output = stdout;
+	if (argc == 3)
+	{
+		output = std::fopen(argv[2], "w");
+		if (output == nullptr)
+		{
+			std::fprintf(stderr, "couldn't open '%s'\n", argv[2]);
+			return 1;
+		}
+	}
+
+	bool success = bmashina::write_chrome_trace(data.data(), data.size(), output);
+	if (output != stdout)
+	{
+		success = (std::fclose(output) == 0) && success;
+	}
+
+	if (!success)
+	{
+		std::fprintf(stderr, "'%s' is not a valid trace\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}